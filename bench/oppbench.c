@@ -0,0 +1,531 @@
+/* oppbench.c - performance per watt of MPU rate/voltage points
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this package. If not, see http://www.gnu.org/licenses/.
+ *
+ * usage: oppbench [options] <rate Hz>:<uV> ...
+ *
+ * Every point is written to /proc/opptimizer as "opp <n> <rate> <uV>",
+ * the CPU is held at OPP n with the userspace governor, and three fixed
+ * kernels run for --time ms each: integer, floating point (NEON on the
+ * N9, see the Makefile) and memory bandwidth. The rate and voltage the
+ * module reports in /proc/opptimizer_stat afterwards are recorded with
+ * the throughput. The OPP and the governor are put back at the end.
+ *
+ * v2f is (V/V0)^2 * (f/f0) against the first point, with V the rail
+ * voltage the module reported: the dynamic power relative to it.
+ * energy is v2f divided by the relative integer throughput, the energy
+ * per unit of work relative to the first point.
+ * Leakage is not in either, so both flatter high voltages a little.
+ *
+ * A regular file given as --proc works as a fake module for testing on a
+ * host: the commands are appended to it and the values are read from the
+ * regular file named like the stat file. Without a cpufreq directory the
+ * CPU is not pinned.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * Local definitions
+ */
+
+#define OPB_DEF_PROC        "/proc/opptimizer"
+#define OPB_STAT_SUFFIX     "_stat"
+#define OPB_DEF_CPUFREQ     "/sys/devices/system/cpu/cpu0/cpufreq"
+#define OPB_DEF_TIME_MS     1000
+#define OPB_DEF_SETTLE_MS   200
+#define OPB_PATH_MAX        256
+#define OPB_LINE_MAX        256
+#define OPB_POINTS_MAX      32
+#define OPB_SR_ERRMINLIMIT  0x16        /* OPP_XITION_SR_ERRMINLIMIT */
+#define OPB_GOV_MAX         32
+
+#define OPB_INT_CHUNK       (1 << 16)   /* iterations between clock reads */
+#define OPB_FP_WORDS        1024        /* 3 x 4KB, stays in L1 */
+#define OPB_FP_CHUNK        64
+#define OPB_MEM_BYTES       (8 << 20)   /* well past the 256KB L2 */
+
+struct opb_point {
+    unsigned long rate;         /* requested */
+    unsigned long u_volt;
+    int ret;                    /* 0 or -errno from the write */
+    unsigned long cur_rate;     /* reported afterwards */
+    unsigned long vp_volt;
+    double int_mops;
+    double fp_mflops;
+    double mem_mbps;
+};
+
+struct opb_ctx {
+    const char *proc;
+    char stat[OPB_PATH_MAX];
+    const char *cpufreq;
+    int index;
+    unsigned int time_ms;
+    unsigned int settle_ms;
+    int json;
+    int pinned;
+    char old_gov[OPB_GOV_MAX];
+};
+
+/* Results go through here so the kernels can't be optimised away */
+static volatile unsigned long opb_sink;
+
+static float opb_fa[OPB_FP_WORDS], opb_fb[OPB_FP_WORDS], opb_fc[OPB_FP_WORDS];
+
+/*
+ * Declarations
+ */
+
+static void opb_usage(const char *appName);
+
+/*
+ * Support functions
+ */
+
+static void opb_usage(const char *appName)
+{
+    fprintf(stderr,
+        "usage: %s [--proc path] [--cpufreq dir] [--opp n] [--time ms]\n"
+        "       [--settle ms] [--json] <rate Hz>:<uV> ...\n",
+        appName);
+}
+
+static double opb_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void opb_sleep_ms(unsigned int ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+static int opb_write(const char *path, const char *s, int append)
+{
+    int fd, rv = 0;
+    ssize_t len = strlen(s);
+
+    fd = open(path, O_WRONLY | (append ? O_APPEND : 0));
+    if (fd < 0)
+        return -errno;
+    if (write(fd, s, len) != len)
+        rv = errno ? -errno : -EIO;
+    close(fd);
+    return rv;
+}
+
+static int opb_read_line(const char *path, char *buf, size_t size)
+{
+    FILE *f;
+    char *nl;
+
+    f = fopen(path, "r");
+    if (f == NULL)
+        return -errno;
+    if (fgets(buf, size, f) == NULL) {
+        fclose(f);
+        return -EIO;
+    }
+    fclose(f);
+    nl = strchr(buf, '\n');
+    if (nl != NULL)
+        *nl = '\0';
+    return 0;
+}
+
+/* Looks up "<key>=<value>" in the stat file, value is the rest of the line */
+static int opb_stat_get(const struct opb_ctx *ctx, const char *key,
+                        char *value, size_t size)
+{
+    char line[OPB_LINE_MAX];
+    size_t klen = strlen(key);
+    FILE *f;
+    int rv = -ENOENT;
+
+    f = fopen(ctx->stat, "r");
+    if (f == NULL)
+        return -errno;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, key, klen) != 0 || line[klen] != '=')
+            continue;
+        strncpy(value, line + klen + 1, size - 1);
+        value[size - 1] = '\0';
+        value[strcspn(value, "\n")] = '\0';
+        rv = 0;
+        break;
+    }
+    fclose(f);
+    return rv;
+}
+
+static int opb_stat_ulong(const struct opb_ctx *ctx, const char *key,
+                          unsigned long *out)
+{
+    char value[OPB_LINE_MAX];
+    int rv;
+
+    rv = opb_stat_get(ctx, key, value, sizeof(value));
+    if (rv < 0)
+        return rv;
+    if (sscanf(value, "%lu", out) != 1)
+        return -EINVAL;
+    return 0;
+}
+
+/* The voltage to put OPP n back to, from the opp_fields layout:
+ * enabled rate default_rate u_volt_nominal u_volt_calib u_volt_dyn_nominal
+ * u_volt_dyn_margin sr_nvalue sr_errminlimit ... An explicit voltage
+ * always sets the tight SmartReflex limit (OPP_XITION_SR_ERRMINLIMIT),
+ * any other limit means the OPP is at its default voltage, which is
+ * asked for with 0. */
+static int opb_stat_opp(const struct opb_ctx *ctx, int n,
+                        unsigned long *rate, unsigned long *u_volt)
+{
+    char key[16], value[OPB_LINE_MAX];
+    unsigned long f[9];
+    int rv;
+
+    sprintf(key, "opp%d", n);
+    rv = opb_stat_get(ctx, key, value, sizeof(value));
+    if (rv < 0)
+        return rv;
+    if (sscanf(value, "%lu %lu %lu %lu %lu %lu %lu %lu %lu", &f[0], &f[1],
+               &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8]) != 9)
+        return -EINVAL;
+    *rate = f[1];
+    *u_volt = f[8] == OPB_SR_ERRMINLIMIT ? f[4] : 0;
+    return 0;
+}
+
+static int opb_set_point(const struct opb_ctx *ctx, unsigned long rate,
+                         unsigned long u_volt)
+{
+    char cmd[OPB_LINE_MAX];
+
+    sprintf(cmd, "opp %d %lu %lu\n", ctx->index, rate, u_volt);
+    return opb_write(ctx->proc, cmd, 1);
+}
+
+/*
+ * CPU pinning
+ */
+
+static int opb_cpufreq_path(const struct opb_ctx *ctx, const char *file,
+                            char *path)
+{
+    if (strlen(ctx->cpufreq) + strlen(file) + 2 > OPB_PATH_MAX)
+        return -ENAMETOOLONG;
+    sprintf(path, "%s/%s", ctx->cpufreq, file);
+    return 0;
+}
+
+static int opb_pin_start(struct opb_ctx *ctx)
+{
+    char path[OPB_PATH_MAX];
+    int rv;
+
+    rv = opb_cpufreq_path(ctx, "scaling_governor", path);
+    if (rv < 0)
+        return rv;
+    if (access(path, W_OK) != 0) {
+        fprintf(stderr, "note: %s not writable, the CPU is not pinned\n", path);
+        return 0;
+    }
+    rv = opb_read_line(path, ctx->old_gov, sizeof(ctx->old_gov));
+    if (rv < 0)
+        return rv;
+    rv = opb_write(path, "userspace", 0);
+    if (rv < 0)
+        return rv;
+    ctx->pinned = 1;
+    return 0;
+}
+
+static int opb_pin_rate(const struct opb_ctx *ctx, unsigned long rate)
+{
+    char path[OPB_PATH_MAX], khz[24];
+    int rv;
+
+    if (!ctx->pinned)
+        return 0;
+    rv = opb_cpufreq_path(ctx, "scaling_setspeed", path);
+    if (rv < 0)
+        return rv;
+    sprintf(khz, "%lu", rate / 1000);
+    return opb_write(path, khz, 0);
+}
+
+static void opb_pin_stop(const struct opb_ctx *ctx)
+{
+    char path[OPB_PATH_MAX];
+
+    if (!ctx->pinned)
+        return;
+    if (opb_cpufreq_path(ctx, "scaling_governor", path) == 0)
+        opb_write(path, ctx->old_gov, 0);
+}
+
+/*
+ * Kernels. Each runs in chunks until the time is up and returns the
+ * work done per second.
+ */
+
+static double opb_run_int(unsigned int time_ms)
+{
+    unsigned long x = 0x12345678UL, y = 0x9abcdef0UL, n = 0;
+    double start = opb_now(), end = start + time_ms / 1000.0, now;
+    int i;
+
+    do {
+        /* xorshift and multiply, 6 ops per iteration */
+        for (i = 0; i < OPB_INT_CHUNK; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            y = y * 69069UL + x;
+        }
+        n += OPB_INT_CHUNK;
+        now = opb_now();
+    } while (now < end);
+    opb_sink = x ^ y;
+    return n * 6.0 / (now - start);
+}
+
+/* c = a * b + c over three L1 resident arrays, which gcc vectorises */
+static double opb_run_fp(unsigned int time_ms)
+{
+    double start = opb_now(), end = start + time_ms / 1000.0, now;
+    unsigned long n = 0;
+    int i, j;
+
+    for (i = 0; i < OPB_FP_WORDS; i++) {
+        opb_fa[i] = 1.0f + i * 1e-6f;
+        opb_fb[i] = 0.999999f;
+        opb_fc[i] = 0.0f;
+    }
+    do {
+        for (j = 0; j < OPB_FP_CHUNK; j++) {
+            for (i = 0; i < OPB_FP_WORDS; i++)
+                opb_fc[i] = opb_fa[i] * opb_fb[i] + opb_fc[i];
+        }
+        n += OPB_FP_CHUNK;
+        now = opb_now();
+    } while (now < end);
+    opb_sink = (unsigned long)opb_fc[OPB_FP_WORDS / 2];
+    return n * OPB_FP_WORDS * 2.0 / (now - start);
+}
+
+/* memcpy between two halves of a buffer much larger than L2, counting
+ * both the read and the write */
+static double opb_run_mem(unsigned int time_ms, char *buf)
+{
+    double start = opb_now(), end = start + time_ms / 1000.0, now;
+    unsigned long n = 0;
+
+    memset(buf, 0x5a, OPB_MEM_BYTES);
+    do {
+        memcpy(buf + OPB_MEM_BYTES / 2, buf, OPB_MEM_BYTES / 2);
+        memcpy(buf, buf + OPB_MEM_BYTES / 2, OPB_MEM_BYTES / 2);
+        n += OPB_MEM_BYTES * 2UL;
+        now = opb_now();
+    } while (now < end);
+    opb_sink = buf[OPB_MEM_BYTES - 1];
+    return n / (now - start);
+}
+
+static void opb_measure(const struct opb_ctx *ctx, struct opb_point *p,
+                        char *membuf)
+{
+    p->ret = opb_set_point(ctx, p->rate, p->u_volt);
+    if (p->ret == 0)
+        p->ret = opb_pin_rate(ctx, p->rate);
+    if (p->ret < 0)
+        return;
+    opb_sleep_ms(ctx->settle_ms);
+    opb_stat_ulong(ctx, "cur_rate", &p->cur_rate);
+    opb_stat_ulong(ctx, "vp_volt", &p->vp_volt);
+
+    p->int_mops = opb_run_int(ctx->time_ms) / 1e6;
+    p->fp_mflops = opb_run_fp(ctx->time_ms) / 1e6;
+    p->mem_mbps = opb_run_mem(ctx->time_ms, membuf) / 1e6;
+}
+
+/*
+ * Output
+ */
+
+/* The rail voltage the module reported. A point asked for with 0 runs at
+ * the default voltage, the request alone doesn't say which, so it is
+ * only used when the stat file couldn't be read. */
+static unsigned long opb_volt(const struct opb_point *p)
+{
+    return p->vp_volt ? p->vp_volt : p->u_volt;
+}
+
+static void opb_derived(const struct opb_point *p, const struct opb_point *ref,
+                        double *v2f, double *energy)
+{
+    double v, f;
+
+    *v2f = 0.0;
+    *energy = 0.0;
+    if (p->ret < 0 || ref->ret < 0 || !opb_volt(ref) || !ref->rate)
+        return;
+    v = (double)opb_volt(p) / opb_volt(ref);
+    f = (double)p->rate / ref->rate;
+    *v2f = v * v * f;
+    if (p->int_mops > 0.0 && ref->int_mops > 0.0)
+        *energy = *v2f / (p->int_mops / ref->int_mops);
+}
+
+static void opb_print(const struct opb_ctx *ctx, const struct opb_point *pts,
+                      int count)
+{
+    double v2f, energy;
+    int i;
+
+    if (ctx->json)
+        printf("[\n");
+    else
+        printf("rate,u_volt,ret,cur_rate,vp_volt,int_mops,fp_mflops,mem_mbps,"
+            "v2f,energy\n");
+    for (i = 0; i < count; i++) {
+        opb_derived(&pts[i], &pts[0], &v2f, &energy);
+        if (ctx->json)
+            printf("  {\"rate\": %lu, \"u_volt\": %lu, \"ret\": %d, "
+                "\"cur_rate\": %lu, \"vp_volt\": %lu, \"int_mops\": %.1f, "
+                "\"fp_mflops\": %.1f, \"mem_mbps\": %.1f, \"v2f\": %.4f, "
+                "\"energy\": %.4f}%s\n",
+                pts[i].rate, pts[i].u_volt, pts[i].ret, pts[i].cur_rate,
+                pts[i].vp_volt, pts[i].int_mops, pts[i].fp_mflops,
+                pts[i].mem_mbps, v2f, energy, i + 1 < count ? "," : "");
+        else
+            printf("%lu,%lu,%d,%lu,%lu,%.1f,%.1f,%.1f,%.4f,%.4f\n",
+                pts[i].rate, pts[i].u_volt, pts[i].ret, pts[i].cur_rate,
+                pts[i].vp_volt, pts[i].int_mops, pts[i].fp_mflops,
+                pts[i].mem_mbps, v2f, energy);
+    }
+    if (ctx->json)
+        printf("]\n");
+}
+
+/*
+ * Entry point
+ */
+
+int main(int argc, char *argv[])
+{
+    static const struct option opts[] = {
+        { "proc", required_argument, NULL, 'p' },
+        { "cpufreq", required_argument, NULL, 'c' },
+        { "opp", required_argument, NULL, 'n' },
+        { "time", required_argument, NULL, 't' },
+        { "settle", required_argument, NULL, 's' },
+        { "json", no_argument, NULL, 'j' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *appName = argv[0];
+    struct opb_ctx ctx;
+    struct opb_point pts[OPB_POINTS_MAX];
+    unsigned long old_rate, old_volt;
+    char value[OPB_LINE_MAX];
+    char *membuf;
+    int count = 0, opt, i, rv = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.proc = OPB_DEF_PROC;
+    ctx.cpufreq = OPB_DEF_CPUFREQ;
+    ctx.time_ms = OPB_DEF_TIME_MS;
+    ctx.settle_ms = OPB_DEF_SETTLE_MS;
+
+    while ((opt = getopt_long(argc, argv, "p:c:n:t:s:j", opts, NULL)) != -1) {
+        switch (opt) {
+        case 'p': ctx.proc = optarg; break;
+        case 'c': ctx.cpufreq = optarg; break;
+        case 'n': if (sscanf(optarg, "%d", &ctx.index) != 1 || ctx.index < 0) rv = -EINVAL; break;
+        case 't': if (sscanf(optarg, "%u", &ctx.time_ms) != 1) rv = -EINVAL; break;
+        case 's': if (sscanf(optarg, "%u", &ctx.settle_ms) != 1) rv = -EINVAL; break;
+        case 'j': ctx.json = 1; break;
+        default: rv = -EINVAL; break;
+        }
+        if (rv < 0) {
+            opb_usage(appName);
+            return 2;
+        }
+    }
+    if (optind == argc || argc - optind > OPB_POINTS_MAX) {
+        opb_usage(appName);
+        return 2;
+    }
+    memset(pts, 0, sizeof(pts));
+    for (i = optind; i < argc; i++, count++) {
+        if (sscanf(argv[i], "%lu:%lu", &pts[count].rate, &pts[count].u_volt) != 2) {
+            fprintf(stderr, "%s: bad point %s, want <rate Hz>:<uV>\n", appName, argv[i]);
+            return 2;
+        }
+    }
+    if (strlen(ctx.proc) + sizeof(OPB_STAT_SUFFIX) > sizeof(ctx.stat)) {
+        fprintf(stderr, "%s: path too long\n", appName);
+        return 2;
+    }
+    sprintf(ctx.stat, "%s%s", ctx.proc, OPB_STAT_SUFFIX);
+
+    /* Where to go back to */
+    if (opb_stat_get(&ctx, "version", value, sizeof(value)) < 0 ||
+        opb_stat_opp(&ctx, ctx.index, &old_rate, &old_volt) < 0) {
+        fprintf(stderr, "%s: can't read OPP%d from %s\n", appName, ctx.index, ctx.stat);
+        return 1;
+    }
+    membuf = malloc(OPB_MEM_BYTES);
+    if (membuf == NULL) {
+        fprintf(stderr, "%s: out of memory\n", appName);
+        return 1;
+    }
+    rv = opb_pin_start(&ctx);
+    if (rv < 0) {
+        fprintf(stderr, "%s: can't set the userspace governor: %s\n", appName, strerror(-rv));
+        return 1;
+    }
+
+    for (i = 0; i < count; i++) {
+        opb_measure(&ctx, &pts[i], membuf);
+        if (pts[i].ret < 0)
+            fprintf(stderr, "%s: %lu Hz at %lu uV: %s\n", appName,
+                pts[i].rate, pts[i].u_volt, strerror(-pts[i].ret));
+    }
+
+    rv = opb_set_point(&ctx, old_rate, old_volt);
+    opb_pin_stop(&ctx);
+    if (rv < 0)
+        fprintf(stderr, "%s: can't restore OPP%d: %s\n", appName, ctx.index, strerror(-rv));
+    free(membuf);
+
+    opb_print(&ctx, pts, count);
+    return rv < 0 ? 1 : 0;
+}
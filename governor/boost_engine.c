@@ -0,0 +1,93 @@
+/*
+ * boost_engine.c - decision logic of the oppboost governor
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * Plain C only, see boost_engine.h.
+ */
+#include "boost_engine.h"
+
+void boost_engine_init(struct boost_engine *e, const struct boost_params *p)
+{
+	e->p = *p;
+	e->boosted = 0;
+	e->above_ms = 0;
+	e->below_ms = 0;
+	e->boost_ms = 0;
+	e->base_ms = 0;
+	e->boost_count = 0;
+}
+
+/* The thresholds must leave a gap, or the engine could boost and drop
+ * back on the same load. */
+int boost_params_valid(const struct boost_params *p)
+{
+	return p->up_threshold <= 100 &&
+	       p->down_threshold < p->up_threshold;
+}
+
+/**
+ * boost_engine_step - feed one load sample
+ * @e:		the engine
+ * @load:	busy percentage over the sample, 0 - 100
+ * @dt_ms:	length of the sample
+ *
+ * The boost is entered once the load has been at or above up_threshold
+ * for boost_window_ms without a break, and left once it has been below
+ * down_threshold for cooldown_ms without a break. Any sample that breaks
+ * the condition restarts the count, so short spikes don't start a boost
+ * and short dips don't end one. Returns the new boost state.
+ */
+int boost_engine_step(struct boost_engine *e, unsigned int load, unsigned int dt_ms)
+{
+	if (e->boosted)
+		e->boost_ms += dt_ms;
+	else
+		e->base_ms += dt_ms;
+
+	if (!e->boosted) {
+		if (load >= e->p.up_threshold)
+			e->above_ms += dt_ms;
+		else
+			e->above_ms = 0;
+		if (e->above_ms >= e->p.boost_window_ms) {
+			e->boosted = 1;
+			e->boost_count++;
+			e->below_ms = 0;
+		}
+	} else {
+		if (load < e->p.down_threshold)
+			e->below_ms += dt_ms;
+		else
+			e->below_ms = 0;
+		if (e->below_ms >= e->p.cooldown_ms) {
+			e->boosted = 0;
+			e->above_ms = 0;
+		}
+	}
+	return e->boosted;
+}
+
+/**
+ * boost_engine_target - frequency to ask cpufreq for
+ * @e:		the engine, after boost_engine_step()
+ * @load:	the same load sample
+ * @min_khz:	policy minimum
+ * @base_khz:	highest frequency allowed without the boost
+ * @boost_khz:	the overclocked frequency
+ *
+ * While boosted that is @boost_khz. Otherwise the load is spread
+ * linearly between @min_khz and @base_khz, and a load at or above
+ * up_threshold gets @base_khz straight away.
+ */
+unsigned int boost_engine_target(const struct boost_engine *e, unsigned int load,
+				 unsigned int min_khz, unsigned int base_khz,
+				 unsigned int boost_khz)
+{
+	if (e->boosted)
+		return boost_khz;
+	if (load >= e->p.up_threshold || base_khz <= min_khz)
+		return base_khz;
+	/* kHz spans stay well under 2^32 / 100, no 64 bit division needed */
+	return min_khz + (base_khz - min_khz) * load / 100;
+}
@@ -0,0 +1,65 @@
+/*
+ * boost_engine.h - decision logic of the oppboost governor
+ *
+ * Pure integer C with no kernel dependencies, so the same code runs in
+ * cpufreq_oppboost.ko and in the host replay tool (replay.c). Everything
+ * the engine knows arrives through boost_engine_step(): one load sample
+ * and the time it covers.
+ */
+#ifndef _BOOST_ENGINE_H_
+#define _BOOST_ENGINE_H_
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+typedef uint64_t u64;
+#endif
+
+/**
+ * struct boost_params - tunables, all exposed in sysfs
+ * @up_threshold:	load (%) at or above which the boost window fills
+ * @down_threshold:	load (%) below which the cooldown runs
+ * @boost_window_ms:	time the load has to stay high before boosting
+ * @cooldown_ms:	time the load has to stay low before dropping back
+ */
+struct boost_params {
+	unsigned int up_threshold;
+	unsigned int down_threshold;
+	unsigned int boost_window_ms;
+	unsigned int cooldown_ms;
+};
+
+#define BOOST_DEF_UP_THRESHOLD		90
+#define BOOST_DEF_DOWN_THRESHOLD	60
+#define BOOST_DEF_WINDOW_MS		200
+#define BOOST_DEF_COOLDOWN_MS		500
+
+/**
+ * struct boost_engine - state of one engine
+ * @p:			current tunables
+ * @boosted:		non-zero while the overclocked OPP is allowed
+ * @above_ms:		how long the load has been at or above up_threshold
+ * @below_ms:		how long the load has been under down_threshold
+ * @boost_ms:		total time spent boosted
+ * @base_ms:		total time spent not boosted
+ * @boost_count:	number of times the boost was entered
+ */
+struct boost_engine {
+	struct boost_params p;
+	int boosted;
+	unsigned int above_ms;
+	unsigned int below_ms;
+	u64 boost_ms;
+	u64 base_ms;
+	unsigned int boost_count;
+};
+
+void boost_engine_init(struct boost_engine *e, const struct boost_params *p);
+int boost_params_valid(const struct boost_params *p);
+int boost_engine_step(struct boost_engine *e, unsigned int load, unsigned int dt_ms);
+unsigned int boost_engine_target(const struct boost_engine *e, unsigned int load,
+				 unsigned int min_khz, unsigned int base_khz,
+				 unsigned int boost_khz);
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ * cpufreq_oppboost.ko - load aware boost governor for opptimizer
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * opptimizer raises policy->max to the overclocked top OPP, and any
+ * stock governor then jumps there on the first busy sample. This one
+ * keeps the top frequency in reserve: below it the frequency follows
+ * the load like ondemand does, and the top frequency is only used once
+ * the load has stayed high for boost_window_ms. It is given up again
+ * after cooldown_ms of low load. The decision logic is boost_engine.c,
+ * shared with the host replay tool.
+ *
+ * sysfs, /sys/devices/system/cpu/cpu0/cpufreq/oppboost/:
+ *   sampling_rate		sampling period in us
+ *   up_threshold		load (%) that fills the boost window
+ *   down_threshold		load (%) under which the cooldown runs
+ *   boost_window_ms		high load time before boosting
+ *   cooldown_ms		low load time before dropping back
+ *   boosted			1 while the top frequency is allowed (ro)
+ *   boost_count		boosts since the governor started (ro)
+ *   boost_residency_ms	time spent boosted (ro)
+ *   base_residency_ms		time spent not boosted (ro)
+ */
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/tick.h>
+#include <linux/sysfs.h>
+
+#include "boost_engine.h"
+
+#define DRIVER_AUTHOR "Lance Colton <lance.colton@gmail.com>\n"
+#define DRIVER_DESCRIPTION "cpufreq_oppboost.ko - load aware boost governor for opptimizer\n"
+#define DRIVER_VERSION "1.0"
+
+MODULE_AUTHOR(DRIVER_AUTHOR);
+MODULE_DESCRIPTION(DRIVER_DESCRIPTION);
+MODULE_VERSION(DRIVER_VERSION);
+MODULE_LICENSE("GPL");
+
+#define SAMPLING_RATE_DEF	20000		/* us */
+#define SAMPLING_RATE_MIN	10000		/* us */
+#define TRANSITION_LATENCY_LIMIT	(10 * 1000 * 1000)	/* ns */
+
+/* oppboost_mutex protects everything below. The sampling work takes
+ * it too, so the governor callbacks cancel the work outside of it. */
+static DEFINE_MUTEX(oppboost_mutex);
+static struct cpufreq_policy *cur_policy;
+static struct boost_engine engine;
+static struct boost_params params = {
+	.up_threshold		= BOOST_DEF_UP_THRESHOLD,
+	.down_threshold		= BOOST_DEF_DOWN_THRESHOLD,
+	.boost_window_ms	= BOOST_DEF_WINDOW_MS,
+	.cooldown_ms		= BOOST_DEF_COOLDOWN_MS,
+};
+static unsigned int sampling_rate = SAMPLING_RATE_DEF;
+static u64 prev_idle, prev_wall;
+static struct delayed_work sample_work;
+
+/* Highest valid frequency below policy->max, i.e. the fastest the CPU
+ * may run without the boost. If there is none, policy->max itself. */
+static unsigned int oppboost_base_khz(struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *table = cpufreq_frequency_get_table(policy->cpu);
+	unsigned int f, base = 0;
+	int i;
+
+	if (!table)
+		return policy->max;
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		f = table[i].frequency;
+		if (f == CPUFREQ_ENTRY_INVALID || f < policy->min || f >= policy->max)
+			continue;
+		if (f > base)
+			base = f;
+	}
+	return base ? base : policy->max;
+}
+
+static void oppboost_sample(struct work_struct *work)
+{
+	struct cpufreq_policy *policy;
+	unsigned int d_wall, d_idle, load, target;
+	u64 idle, wall;
+
+	mutex_lock(&oppboost_mutex);
+	policy = cur_policy;
+	if (!policy) {
+		mutex_unlock(&oppboost_mutex);
+		return;
+	}
+
+	/* One sampling period is far below 2^32us, so 32 bits do. */
+	idle = get_cpu_idle_time_us(policy->cpu, &wall);
+	d_wall = (unsigned int)(wall - prev_wall);
+	d_idle = (unsigned int)(idle - prev_idle);
+	prev_wall = wall;
+	prev_idle = idle;
+	load = (d_wall && d_idle < d_wall) ? 100 * (d_wall - d_idle) / d_wall : 0;
+
+	boost_engine_step(&engine, load, d_wall / 1000);
+	target = boost_engine_target(&engine, load, policy->min,
+				     oppboost_base_khz(policy), policy->max);
+	if (target != policy->cur)
+		__cpufreq_driver_target(policy, target, engine.boosted ?
+					CPUFREQ_RELATION_H : CPUFREQ_RELATION_L);
+
+	schedule_delayed_work(&sample_work, usecs_to_jiffies(sampling_rate));
+	mutex_unlock(&oppboost_mutex);
+}
+
+#define show_one(name, fmt, value)					\
+static ssize_t show_##name(struct cpufreq_policy *unused, char *buf)	\
+{									\
+	return sprintf(buf, fmt "\n", value);				\
+}
+show_one(sampling_rate, "%u", sampling_rate);
+show_one(up_threshold, "%u", params.up_threshold);
+show_one(down_threshold, "%u", params.down_threshold);
+show_one(boost_window_ms, "%u", params.boost_window_ms);
+show_one(cooldown_ms, "%u", params.cooldown_ms);
+show_one(boosted, "%d", engine.boosted);
+show_one(boost_count, "%u", engine.boost_count);
+show_one(boost_residency_ms, "%llu", (unsigned long long)engine.boost_ms);
+show_one(base_residency_ms, "%llu", (unsigned long long)engine.base_ms);
+
+static ssize_t store_sampling_rate(struct cpufreq_policy *unused,
+				   const char *buf, size_t count)
+{
+	unsigned int input;
+
+	if (sscanf(buf, "%u", &input) != 1)
+		return -EINVAL;
+	mutex_lock(&oppboost_mutex);
+	sampling_rate = max(input, (unsigned int)SAMPLING_RATE_MIN);
+	mutex_unlock(&oppboost_mutex);
+	return count;
+}
+
+/* Each parameter is checked together with the others, a write that
+ * would close the gap between the thresholds is refused. */
+#define store_param(name)						\
+static ssize_t store_##name(struct cpufreq_policy *unused,		\
+			    const char *buf, size_t count)		\
+{									\
+	struct boost_params p;						\
+	unsigned int input;						\
+	int ret = count;						\
+									\
+	if (sscanf(buf, "%u", &input) != 1)				\
+		return -EINVAL;						\
+	mutex_lock(&oppboost_mutex);					\
+	p = params;							\
+	p.name = input;							\
+	if (boost_params_valid(&p))					\
+		params = engine.p = p;					\
+	else								\
+		ret = -EINVAL;						\
+	mutex_unlock(&oppboost_mutex);					\
+	return ret;							\
+}
+store_param(up_threshold);
+store_param(down_threshold);
+store_param(boost_window_ms);
+store_param(cooldown_ms);
+
+#define define_one_rw(name) \
+static struct freq_attr name##_attr = __ATTR(name, 0644, show_##name, store_##name)
+#define define_one_ro(name) \
+static struct freq_attr name##_attr = __ATTR(name, 0444, show_##name, NULL)
+
+define_one_rw(sampling_rate);
+define_one_rw(up_threshold);
+define_one_rw(down_threshold);
+define_one_rw(boost_window_ms);
+define_one_rw(cooldown_ms);
+define_one_ro(boosted);
+define_one_ro(boost_count);
+define_one_ro(boost_residency_ms);
+define_one_ro(base_residency_ms);
+
+static struct attribute *oppboost_attributes[] = {
+	&sampling_rate_attr.attr,
+	&up_threshold_attr.attr,
+	&down_threshold_attr.attr,
+	&boost_window_ms_attr.attr,
+	&cooldown_ms_attr.attr,
+	&boosted_attr.attr,
+	&boost_count_attr.attr,
+	&boost_residency_ms_attr.attr,
+	&base_residency_ms_attr.attr,
+	NULL
+};
+
+static struct attribute_group oppboost_attr_group = {
+	.attrs = oppboost_attributes,
+	.name = "oppboost",
+};
+
+static int cpufreq_governor_oppboost(struct cpufreq_policy *policy,
+				     unsigned int event)
+{
+	u64 wall;
+	int ret;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		/* Idle time accounting needs NO_HZ, without it there is
+		 * nothing to base a decision on. */
+		if (get_cpu_idle_time_us(policy->cpu, &wall) == -1ULL)
+			return -EINVAL;
+		ret = sysfs_create_group(&policy->kobj, &oppboost_attr_group);
+		if (ret)
+			return ret;
+		mutex_lock(&oppboost_mutex);
+		cur_policy = policy;
+		boost_engine_init(&engine, &params);
+		prev_idle = get_cpu_idle_time_us(policy->cpu, &prev_wall);
+		schedule_delayed_work(&sample_work, usecs_to_jiffies(sampling_rate));
+		mutex_unlock(&oppboost_mutex);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&oppboost_mutex);
+		cur_policy = NULL;
+		mutex_unlock(&oppboost_mutex);
+		cancel_delayed_work_sync(&sample_work);
+		sysfs_remove_group(&policy->kobj, &oppboost_attr_group);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&oppboost_mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy, policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy, policy->min, CPUFREQ_RELATION_L);
+		mutex_unlock(&oppboost_mutex);
+		break;
+	}
+	return 0;
+}
+
+static struct cpufreq_governor cpufreq_gov_oppboost = {
+	.name			= "oppboost",
+	.governor		= cpufreq_governor_oppboost,
+	.max_transition_latency	= TRANSITION_LATENCY_LIMIT,
+	.owner			= THIS_MODULE,
+};
+
+static int __init oppboost_init(void)
+{
+	INIT_DELAYED_WORK(&sample_work, oppboost_sample);
+	return cpufreq_register_governor(&cpufreq_gov_oppboost);
+}
+
+static void __exit oppboost_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_oppboost);
+}
+
+module_init(oppboost_init);
+module_exit(oppboost_exit);
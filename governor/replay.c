@@ -0,0 +1,138 @@
+/* replay.c - run a load trace through the oppboost decision engine
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Host tool, not shipped in the package. It feeds recorded load samples
+ * to the same boost_engine.c the governor uses, so tunables can be tried
+ * offline before they are written to sysfs on the phone.
+ *
+ * Input, one sample per line, '#' starts a comment:
+ *     <load %> [<duration ms>]
+ * The duration defaults to the -s sampling period.
+ *
+ * Output is CSV on stdout, one line per sample:
+ *     t_ms,load,boosted,target_khz
+ * followed by a summary on stderr.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "boost_engine.h"
+
+/*
+ * Local definitions
+ */
+
+#define RPL_DEF_SAMPLE_MS   20
+#define RPL_DEF_MIN_KHZ     300000
+#define RPL_DEF_BASE_KHZ    1000000
+#define RPL_DEF_BOOST_KHZ   1400000
+#define RPL_LINE_MAX        256
+
+/*
+ * Support functions
+ */
+
+static void rpl_usage(const char *appName)
+{
+    fprintf(stderr,
+        "usage: %s [-u up%%] [-d down%%] [-w window_ms] [-c cooldown_ms]\n"
+        "       [-s sample_ms] [-f min_khz,base_khz,boost_khz] < trace\n",
+        appName);
+}
+
+static int rpl_parse_uint(const char *s, unsigned int *out)
+{
+    char *end;
+    unsigned long v;
+
+    errno = 0;
+    v = strtoul(s, &end, 10);
+    if (errno != 0 || end == s || *end != '\0')
+        return -EINVAL;
+    *out = (unsigned int)v;
+    return 0;
+}
+
+/*
+ * Entry point
+ */
+
+int main(int argc, char *argv[])
+{
+    const char *appName = argv[0];
+    struct boost_params p;
+    struct boost_engine e;
+    unsigned int sample_ms = RPL_DEF_SAMPLE_MS;
+    unsigned int min_khz = RPL_DEF_MIN_KHZ;
+    unsigned int base_khz = RPL_DEF_BASE_KHZ;
+    unsigned int boost_khz = RPL_DEF_BOOST_KHZ;
+    unsigned int load, dt_ms, target;
+    unsigned long long t_ms = 0;
+    unsigned long lineno = 0;
+    char line[RPL_LINE_MAX];
+    char *hash;
+    int opt, n, rv = 0;
+
+    p.up_threshold = BOOST_DEF_UP_THRESHOLD;
+    p.down_threshold = BOOST_DEF_DOWN_THRESHOLD;
+    p.boost_window_ms = BOOST_DEF_WINDOW_MS;
+    p.cooldown_ms = BOOST_DEF_COOLDOWN_MS;
+
+    while ((opt = getopt(argc, argv, "u:d:w:c:s:f:")) != -1) {
+        switch (opt) {
+        case 'u': rv = rpl_parse_uint(optarg, &p.up_threshold); break;
+        case 'd': rv = rpl_parse_uint(optarg, &p.down_threshold); break;
+        case 'w': rv = rpl_parse_uint(optarg, &p.boost_window_ms); break;
+        case 'c': rv = rpl_parse_uint(optarg, &p.cooldown_ms); break;
+        case 's': rv = rpl_parse_uint(optarg, &sample_ms); break;
+        case 'f':
+            if (sscanf(optarg, "%u,%u,%u", &min_khz, &base_khz, &boost_khz) != 3)
+                rv = -EINVAL;
+            break;
+        default:
+            rv = -EINVAL;
+            break;
+        }
+        if (rv < 0) {
+            rpl_usage(appName);
+            return 2;
+        }
+    }
+    if (!boost_params_valid(&p)) {
+        fprintf(stderr, "%s: thresholds need up <= 100 and down < up\n", appName);
+        return 2;
+    }
+
+    boost_engine_init(&e, &p);
+    printf("t_ms,load,boosted,target_khz\n");
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        lineno++;
+        hash = strchr(line, '#');
+        if (hash != NULL)
+            *hash = '\0';
+        dt_ms = sample_ms;
+        n = sscanf(line, "%u %u", &load, &dt_ms);
+        if (n <= 0)
+            continue;
+        if (load > 100) {
+            fprintf(stderr, "%s: line %lu: load over 100%%\n", appName, lineno);
+            return 1;
+        }
+        boost_engine_step(&e, load, dt_ms);
+        target = boost_engine_target(&e, load, min_khz, base_khz, boost_khz);
+        t_ms += dt_ms;
+        printf("%llu,%u,%d,%u\n", t_ms, load, e.boosted, target);
+    }
+
+    fprintf(stderr, "boosts=%u boost_ms=%llu base_ms=%llu\n", e.boost_count,
+        (unsigned long long)e.boost_ms, (unsigned long long)e.base_ms);
+    return 0;
+}
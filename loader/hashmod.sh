@@ -3,8 +3,11 @@ KMOD=../symsearch/symsearch.ko
 HASH1=`cat $KMOD | openssl dgst -binary -sha1 | hexdump -e '1/1 "0x%x,"'`
 KMOD=../opptimizer/opptimizer.ko
 HASH2=`cat $KMOD | openssl dgst -binary -sha1 | hexdump -e '1/1 "0x%x,"'`
+KMOD=../governor/cpufreq_oppboost.ko
+HASH3=`cat $KMOD | openssl dgst -binary -sha1 | hexdump -e '1/1 "0x%x,"'`
 cat - > modhash.inc <<EOF
 static const char OPP_HASH_SYMSEARCH[] = { $HASH1 };
 static const char OPP_HASH_OPPTIMIZER[] = { $HASH2 };
+static const char OPP_HASH_OPPBOOST[] = { $HASH3 };
 EOF
 exit 0
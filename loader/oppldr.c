@@ -17,21 +17,31 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <spawn.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/creds.h>
-#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 
 /*
  * Local definitions
  */
 
-#define OPP_DEVNULL         "/dev/null"
-#define OPP_MODPROBE        "/sbin/modprobe"
+#define OPP_MODULE_DIR      "/lib/modules/2.6.32.48-dfl61-20115101/"
 #define OPP_SHA1_LENGTH     20
-#define OPP_TARGET_MODULE   "opptimizer"
+#define OPP_SYMSEARCH_MODULE OPP_MODULE_DIR "symsearch.ko"
+#define OPP_TARGET_MODULE   OPP_MODULE_DIR "opptimizer.ko"
+#define OPP_GOVERNOR_MODULE OPP_MODULE_DIR "cpufreq_oppboost.ko"
+#define OPP_PROFILE_PATH    "/var/lib/opptimizer/profile"
+#define OPP_PARAMS_MAX      256 /* opptimizer's profile parameter size */
+#define OPP_UNCONFIRMED_PATH "/var/lib/opptimizer/unconfirmed"
+#define OPP_CONFIRM_PARAM   " confirm_s=4294967295"
+#define OPP_PROC_PATH       "/proc/opptimizer"
+#define OPP_SYMCACHE_PATH   "/var/lib/opptimizer/symcache"
+#define OPP_SYMCACHE_SYSFS  "/sys/kernel/symsearch/cache"
+#define OPP_SYMCACHE_MAX    4096 /* one sysfs page */
 #define OPP_WHITELIST_PATH  "/sys/kernel/security/validator/modlist"
 #include "modhash.inc"
 
@@ -40,7 +50,11 @@
  */
 
 static int opp_confine_to_sys_module(void);
-static int opp_load_module(const char *module);
+static int opp_load_module(const char *path, const char *params);
+static int opp_read_file(const char *path, char *buf, size_t size);
+static int opp_confirm(void);
+static int opp_read_profile(char *params, size_t size, unsigned int *confirm);
+static int opp_write_file(const char *path, const char *buf, size_t len);
 static int opp_whitelist_module(const void *hash);
 
 /*
@@ -65,36 +79,158 @@ static int opp_confine_to_sys_module(void)
     return 0;
 }
 
-static int opp_load_module(const char *module)
+static int opp_load_module(const char *path, const char *params)
 {
-    const char *args[] = { OPP_MODPROBE, module, NULL };
-    char *env[] = { NULL };
-    posix_spawn_file_actions_t act;
-    pid_t pid;
-    int st;
-    int rv;
+    struct stat st;
+    char *image;
+    size_t done = 0;
+    ssize_t rres;
+    int fd = -1;
+    int rv = 0;
 
-    /* Invoke modprobe, suppressing error output and clearing the env. */
-    rv = posix_spawn_file_actions_init(&act);
-    if (rv == 0) {
-        rv = -posix_spawn_file_actions_addopen(&act, STDERR_FILENO,
-            OPP_DEVNULL, O_WRONLY, 0);
-        if (rv == 0)
-            rv = -posix_spawn(&pid, args[0], &act, NULL, (char **)args, env);
-        posix_spawn_file_actions_destroy(&act);
+    /* Read the whole module image, init_module() takes it from memory */
+    while (fd == -1) {
+        fd = open(path, O_RDONLY);
+        if (fd == -1 && errno != EINTR)
+            return -errno;
     }
-    if (rv != 0)
+    if (fstat(fd, &st) != 0) {
+        rv = -errno;
+        close(fd);
         return rv;
+    }
+    image = malloc(st.st_size);
+    if (image == NULL) {
+        close(fd);
+        return -ENOMEM;
+    }
+    while (done < (size_t)st.st_size) {
+        rres = read(fd, image + done, st.st_size - done);
+        if (rres < 0 && errno == EINTR)
+            continue;
+        if (rres <= 0) {
+            rv = rres < 0 ? -errno : -EIO;
+            break;
+        }
+        done += rres;
+    }
+    close(fd);
+
+    /* Load it. A module that is already loaded is not an error. */
+    if (rv == 0 && syscall(SYS_init_module, image, done, params) != 0 &&
+        errno != EEXIST)
+        rv = -errno;
+    free(image);
+    return rv;
+}
 
-    /* Wait for the process to complete */
-    for (; ; ) {
-        if (waitpid(pid, &st, 0) == -1) {
-            if (errno == EINTR)
-                continue;
+static int opp_read_file(const char *path, char *buf, size_t size)
+{
+    size_t done = 0;
+    ssize_t rres;
+    int fd = -1;
+    int rv = 0;
+
+    /* Read up to size bytes, returns the length read */
+    while (fd == -1) {
+        fd = open(path, O_RDONLY);
+        if (fd == -1 && errno != EINTR)
             return -errno;
+    }
+    while (done < size) {
+        rres = read(fd, buf + done, size - done);
+        if (rres < 0 && errno == EINTR)
+            continue;
+        if (rres < 0)
+            rv = -errno;
+        if (rres <= 0)
+            break;
+        done += rres;
+    }
+    close(fd);
+    return rv < 0 ? rv : (int)done;
+}
+
+static int opp_write_file(const char *path, const char *buf, size_t len)
+{
+    ssize_t wres;
+    int fd = -1;
+    int rv = 0;
+
+    /* One write, sysfs takes a store in a single call */
+    while (fd == -1) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd == -1 && errno != EINTR)
+            return -errno;
+    }
+    wres = write(fd, buf, len);
+    if (wres < 0)
+        rv = -errno;
+    else if ((size_t)wres != len)
+        rv = -EIO;
+    if (close(fd) != 0 && rv == 0)
+        rv = -errno;
+    return rv;
+}
+
+static int opp_confirm(void)
+{
+    int rv;
+
+    /* Tell opptimizer to keep the profile, then forget the marker */
+    rv = opp_write_file(OPP_PROC_PATH, "confirm", 7);
+    if (rv < 0)
+        return rv;
+    if (unlink(OPP_UNCONFIRMED_PATH) != 0 && errno != ENOENT)
+        return -errno;
+    return 0;
+}
+
+static int opp_read_profile(char *params, size_t size, unsigned int *confirm)
+{
+    static const char prefix[] = "profile=";
+    char line[128];
+    char item[64];
+    unsigned long rate, uv;
+    size_t len;
+    FILE *f;
+    int index, n;
+
+    /* Turn "<n> <rate> [<uV>]" lines into profile=<n>:<rate>:<uV>,...
+     * and a "confirm <s>" line into *confirm */
+    params[0] = '\0';
+    *confirm = 0;
+    f = fopen(OPP_PROFILE_PATH, "r");
+    if (f == NULL)
+        return errno == ENOENT ? 0 : -errno;
+    strcpy(params, prefix);
+    len = sizeof(prefix) - 1;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "confirm %u", confirm) == 1)
+            continue;
+        uv = 0;
+        n = sscanf(line, "%d %lu %lu", &index, &rate, &uv);
+        if (n <= 0)
+            continue;
+        if (n < 2 || index < 0) {
+            fclose(f);
+            return -EINVAL;
+        }
+        n = sprintf(item, "%s%d:%lu:%lu", len > sizeof(prefix) - 1 ? "," : "",
+            index, rate, uv);
+        if (len - (sizeof(prefix) - 1) + n >= OPP_PARAMS_MAX) {
+            fclose(f);
+            return -E2BIG;
         }
-        return WEXITSTATUS(st);
+        memcpy(params + len, item, n + 1);
+        len += n;
     }
+    fclose(f);
+    if (len == sizeof(prefix) - 1)
+        params[0] = '\0';
+    return 0;
 }
 
 static int opp_whitelist_module(const void *hash)
@@ -125,9 +261,23 @@ static int opp_whitelist_module(const void *hash)
 int main(int argc, char *argv[])
 {
     const char *appName = program_invocation_short_name;
+    char params[OPP_PARAMS_MAX + sizeof("profile=") + sizeof(OPP_CONFIRM_PARAM)];
+    static char marker[sizeof(params)];
+    static char cache[OPP_SYMCACHE_MAX];
+    static char fresh[OPP_SYMCACHE_MAX];
+    int cacheLen, freshLen, markerLen;
+    unsigned int confirm;
     int rv;
     struct stat st;
 
+    /* "oppldr confirm" keeps a profile that was applied tentatively */
+    if (argc > 1 && strcmp(argv[1], "confirm") == 0) {
+        rv = opp_confirm();
+        if (rv < 0)
+            goto fault;
+        return 0;
+    }
+
     /* Test if we need to do anything at all */
     if (stat("/proc/opptimizer", &st) == 0)
         return 0;
@@ -139,23 +289,74 @@ int main(int argc, char *argv[])
     rv = opp_whitelist_module(OPP_HASH_SYMSEARCH);
     if (rv >= 0)
         rv = opp_whitelist_module(OPP_HASH_OPPTIMIZER);
+    if (rv >= 0)
+        rv = opp_whitelist_module(OPP_HASH_OPPBOOST);
     if (rv < 0)
         goto fault;
 
-    /* Drop credentials so it's safe to exec things */
+    /* Drop everything but the right to load modules */
     rv = opp_confine_to_sys_module();
     if (rv < 0)
         goto fault;
 
-    /* Load the required module */
-    rv = opp_load_module(OPP_TARGET_MODULE);
+    /* A broken profile must not keep the module from loading */
+    rv = opp_read_profile(params, sizeof(params), &confirm);
+    if (rv < 0) {
+        fprintf(stderr, "%s: %s: %s, loading without it\n", appName,
+            OPP_PROFILE_PATH, strerror(-rv));
+        params[0] = '\0';
+    }
+
+    /* A profile with a "confirm" line is applied tentatively and marked
+     * until "oppldr confirm". If the marker is still there the last boot
+     * never confirmed it, maybe because it hung, so the same profile is
+     * not applied again. Editing the profile or confirming clears that. */
+    if (params[0] != '\0' && confirm != 0) {
+        markerLen = opp_read_file(OPP_UNCONFIRMED_PATH, marker, sizeof(marker));
+        if (markerLen == (int)strlen(params) && memcmp(marker, params, markerLen) == 0) {
+            fprintf(stderr, "%s: profile not confirmed last boot, loading without it\n",
+                appName);
+            params[0] = '\0';
+        } else if ((rv = opp_write_file(OPP_UNCONFIRMED_PATH, params, strlen(params))) < 0) {
+            fprintf(stderr, "%s: %s: %s, loading without the profile\n", appName,
+                OPP_UNCONFIRMED_PATH, strerror(-rv));
+            params[0] = '\0';
+        } else {
+            /* The marker has to survive a hang right after the load */
+            sync();
+            sprintf(params + strlen(params), " confirm_s=%u", confirm);
+        }
+    }
+
+    /* Load the modules, opptimizer applies the profile before it returns.
+     * symsearch checks the saved symbol cache against the running kernel
+     * and refuses it if it doesn't match, opptimizer then falls back to
+     * searching kallsyms. */
+    rv = opp_load_module(OPP_SYMSEARCH_MODULE, "");
+    if (rv < 0)
+        goto fault;
+    cacheLen = opp_read_file(OPP_SYMCACHE_PATH, cache, sizeof(cache));
+    if (cacheLen > 0 && opp_write_file(OPP_SYMCACHE_SYSFS, cache, cacheLen) < 0)
+        cacheLen = 0;
+    rv = opp_load_module(OPP_TARGET_MODULE, params);
     if (rv < 0)
         goto fault;
-    if (rv > 0) {
-        fprintf(stderr, "%s: modprobe returned error %i\n", appName, rv);
-        return 1;
+
+    /* Save the cache again if the load had to add to it or replace it */
+    freshLen = opp_read_file(OPP_SYMCACHE_SYSFS, fresh, sizeof(fresh));
+    if (freshLen > 0 && (freshLen != cacheLen || memcmp(cache, fresh, freshLen) != 0)) {
+        rv = opp_write_file(OPP_SYMCACHE_PATH, fresh, freshLen);
+        if (rv < 0)
+            fprintf(stderr, "%s: %s: %s\n", appName, OPP_SYMCACHE_PATH,
+                strerror(-rv));
     }
 
+    /* The governor is optional, opptimizer works without it */
+    rv = opp_load_module(OPP_GOVERNOR_MODULE, "");
+    if (rv < 0)
+        fprintf(stderr, "%s: %s: %s\n", appName, OPP_GOVERNOR_MODULE,
+            strerror(-rv));
+
     /* Handle errors */
     return 0;
 fault:
@@ -0,0 +1,3152 @@
+/*
+ * opptimizer_n9.ko - The OPP Management API
+ * version 1.5.4
+ * by Lance Colton <lance.colton@gmail.com>
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * Latest Source & changelog:
+ * https://github.com/CreamyG31337/opptimizer-n9
+ *
+ * NOTE: This module uses reverse engineering to access private kernel APIs
+ * that are not exported. It uses symsearch to find unexported kernel symbols
+ * at runtime and call them directly. This is the ONLY way to overclock the
+ * Nokia N9, as there are no public APIs for this functionality.
+ *
+ * WARNING: Direct manipulation of kernel structures is inherently risky and
+ * can cause system instability or crashes if done incorrectly. This code
+ * bypasses normal kernel protections and directly modifies OPP (Operating
+ * Performance Point) structures, voltage tables, and cpufreq policies.
+ */
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/version.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <asm/uaccess.h>
+#include <linux/cpufreq.h>
+#include <plat/common.h>
+#include <plat/opp.h>
+#include <plat/clock.h>
+#include </usr/src/kernel-headers/arch/arm/mach-omap2/voltage.h>
+#include </usr/src/kernel-headers/arch/arm/mach-omap2/prm.h>
+#include <linux/mutex.h>
+#include <linux/miscdevice.h>
+#include <linux/ktime.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/notifier.h>
+#include <linux/delay.h>
+#include <linux/string.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+
+#include "../symsearch/symsearch.h"
+#include "opp_info.h"
+#include "opp_ioctl.h"
+#include "opp_latency.h"
+#include "opp_xition.h"
+#include "opp_probe.h"
+#include "opp_tune.h"
+#include "opp_thermal.h"
+#include "opp_stats.h"
+#include "opp_telemetry.h"
+
+#define DRIVER_AUTHOR "Lance Colton <lance.colton@gmail.com>\n"
+#define DRIVER_DESCRIPTION "opptimizer.ko - The OPP Management API\n\
+https://github.com/CreamyG31337/opptimizer-n9 for source\n\
+This module uses SYMSEARCH by Skrilax_CZ\n\
+Made possible by Jeffrey Kawika Patricio and Tiago Sousa\n"
+#define DRIVER_VERSION "1.5.4"
+
+MODULE_AUTHOR(DRIVER_AUTHOR);
+MODULE_DESCRIPTION(DRIVER_DESCRIPTION);
+MODULE_VERSION(DRIVER_VERSION);
+MODULE_LICENSE("GPL");
+
+/* Function pointer declarations for unexported kernel functions.
+ * These are resolved at runtime using symsearch to find the actual
+ * kernel symbol addresses. Source files noted for reference.
+ */
+
+// opp.c - Operating Performance Point management
+SYMSEARCH_DECLARE_FUNCTION_STATIC(int,
+						opp_get_opp_count_fp, enum opp_t opp_type);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(struct omap_opp *,
+						opp_find_freq_floor_fp, enum opp_t opp_type, unsigned long *freq);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(unsigned long,
+						opp_get_voltage_fp, const struct omap_opp *opp);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(int,
+						opp_disable_fp, struct omap_opp *opp);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(int,
+						opp_enable_fp, struct omap_opp *opp);
+//smartreflex-class1p5.c - SmartReflex voltage calibration
+SYMSEARCH_DECLARE_FUNCTION_STATIC(void,
+						sr_class1p5_reset_calib_fp, int vdd, bool reset, bool recal);
+//voltage.c - Voltage domain management
+SYMSEARCH_DECLARE_FUNCTION_STATIC(unsigned long,
+						omap_voltageprocessor_get_voltage_fp, int vp_id);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(struct omap_volt_data *,
+						omap_get_volt_data_fp, int vdd, unsigned long volt);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(int,
+						omap_voltage_scale_fp, int vdd, struct omap_volt_data *vdata_target, struct omap_volt_data *vdata_current);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(void,
+						vc_setup_on_voltage_fp, u32 vdd, unsigned long target_volt);
+//cpu-omap.c - CPU frequency queries
+SYMSEARCH_DECLARE_FUNCTION_STATIC(unsigned int,
+						omap_getspeed_fp, unsigned int cpu);
+//clock.c - Clock rate management
+SYMSEARCH_DECLARE_FUNCTION_STATIC(long,
+						clk_round_rate_fp, struct clk *clk, unsigned long rate);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(int,
+						clk_set_rate_fp, struct clk *clk, unsigned long rate);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(unsigned long,
+						clk_get_rate_fp, struct clk *clk);
+//clkdev.c - Clock device lookup
+SYMSEARCH_DECLARE_FUNCTION_STATIC(struct clk*,
+						clk_get_fp, struct device *dev, const char *con_id);
+//cpufreq.h - CPU frequency policy updates
+SYMSEARCH_DECLARE_FUNCTION_STATIC(int,
+						cpufreq_update_policy_fp,unsigned int cpu);
+//control.c - System control module registers, for the bandgap sensor
+SYMSEARCH_DECLARE_FUNCTION_STATIC(u32,
+						omap_ctrl_readl_fp, u16 offset);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(void,
+						omap_ctrl_writel_fp, u32 val, u16 offset);
+//prcm.c - PRM registers, for the voltage processor slew
+SYMSEARCH_DECLARE_FUNCTION_STATIC(u32,
+						prm_read_mod_reg_fp, s16 module, u16 idx);
+SYMSEARCH_DECLARE_FUNCTION_STATIC(void,
+						prm_write_mod_reg_fp, u32 val, s16 module, u16 idx);
+//voltage.c - per VDD state array, needed for VDD1's scaling_mutex
+SYMSEARCH_DECLARE_ADDRESS_STATIC(vdd_info);
+
+/* Everything above, resolved in one kallsyms walk at init. Every missing
+ * symbol is logged before the load fails. */
+static struct symsearch_request opp_symbols[] __initdata = {
+	SYMSEARCH_REQUEST_FUNCTION_TO(opp_get_opp_count, opp_get_opp_count_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(opp_find_freq_floor, opp_find_freq_floor_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(opp_get_voltage, opp_get_voltage_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(sr_class1p5_reset_calib, sr_class1p5_reset_calib_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(omap_get_volt_data, omap_get_volt_data_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(omap_getspeed, omap_getspeed_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(clk_round_rate, clk_round_rate_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(clk_set_rate, clk_set_rate_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(clk_get_rate, clk_get_rate_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(clk_get, clk_get_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(omap_voltageprocessor_get_voltage, omap_voltageprocessor_get_voltage_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(omap_voltage_scale, omap_voltage_scale_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(vc_setup_on_voltage, vc_setup_on_voltage_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(opp_disable, opp_disable_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(opp_enable, opp_enable_fp),
+	/* NOTE: These symbols are commented out because they're not needed or
+	 * not available in this kernel version. cpufreq_frequency_get_table()
+	 * is available as a normal exported symbol. Rebuilding the cpufreq_stats
+	 * table would still key it by freq_table[]; opp_stats.c keeps its own. */
+	//SYMSEARCH_REQUEST_FUNCTION_TO(cpufreq_frequency_get_table, cpufreq_frequency_get_table_fp),
+	//SYMSEARCH_REQUEST_FUNCTION_TO(cpufreq_stats_create_table, cpufreq_stats_create_table_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(cpufreq_update_policy, cpufreq_update_policy_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(omap_ctrl_readl, omap_ctrl_readl_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(omap_ctrl_writel, omap_ctrl_writel_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(prm_read_mod_reg, prm_read_mod_reg_fp),
+	SYMSEARCH_REQUEST_FUNCTION_TO(prm_write_mod_reg, prm_write_mod_reg_fp),
+	SYMSEARCH_REQUEST_ADDRESS(vdd_info),
+};
+
+#define OPP_MAX_COUNT	16		/* More than any OMAP3 MPU table has */
+
+/**
+ * struct opp_entry - an MPU OPP managed by this module
+ * @opp:		the kernel's OPP, looked up once at init and kept so
+ *			that disabled OPPs stay addressable
+ * @vdata:		voltage data matching the OPP's nominal voltage
+ * @cpufreq_index:	matching freq_table[] entry, -1 if there is none
+ * @default_rate:	rate at module load, restored on unload
+ * @default_enabled:	enabled state at module load, restored on unload
+ * @default_vdata:	load-time copy of @vdata, points into vdata_defaults[]
+ *
+ * Entries are stored in the order opp_find_freq_floor() walks them,
+ * highest rate first, so index 0 is always the top (overclock) OPP that
+ * the plain "<rate> <uV>" write has always changed.
+ */
+struct opp_entry {
+	struct omap_opp *opp;
+	struct omap_volt_data *vdata;
+	int cpufreq_index;
+	unsigned long default_rate;
+	bool default_enabled;
+	struct omap_volt_data *default_vdata;
+};
+
+static struct opp_entry mpu_opps[OPP_MAX_COUNT];
+static int opp_count, enabled_opp_count;
+
+/* Every VDD1 voltage table entry as it was at module load, in the same
+ * order as vdd1->volt_data[]. OPPs share these entries by voltage, and
+ * entries may be edited on their own with the "vdata" command. All of
+ * them are put back on unload. */
+#define VDATA_MAX_COUNT	16
+static struct omap_volt_data vdata_defaults[VDATA_MAX_COUNT];
+static int vdata_count;
+
+static struct cpufreq_frequency_table *freq_table;
+static struct cpufreq_policy *policy;
+
+/*
+ * Locking: opp_mutex serialises every request that changes an OPP, and
+ * protects buf. While the OPP and voltage tables are edited and the rail
+ * is moved, VDD1's scaling_mutex is held as well. That is the lock the
+ * kernel's own DVFS path holds while it scales, so governor driven
+ * transitions can no longer run in the middle of ours. It is dropped
+ * again before sr_class1p5_reset_calib() and cpufreq_update_policy(),
+ * which both end up taking it themselves.
+ * Readers take no lock at all. Everything they print is a single word
+ * that is only ever replaced whole.
+ */
+static DEFINE_MUTEX(opp_mutex);
+static struct omap_vdd_info *vdd1;
+
+/* Non-zero while the tuner holds cpufreq at the rate it is testing. */
+static unsigned int tune_pin_khz;
+/* Non-zero while the thermal guard limits the MPU rate. */
+static unsigned int thermal_cap_khz;
+
+/* Boot profile, see opp_profile_apply(). profile_status is 0 if it was
+ * applied or empty, -errno if it was rejected. */
+#define PROFILE_LEN	256
+static char profile[PROFILE_LEN];
+module_param_string(profile, profile, sizeof(profile), 0444);
+MODULE_PARM_DESC(profile, "MPU OPPs to apply at load, <n>:<rate>:<uV>,...");
+static int profile_status;
+
+#define MPU_CLK		"arm_fck"	/* MPU (CPU) clock name */
+#define BUF_SIZE PAGE_SIZE		/* Buffer size for procfs I/O */
+static char *buf;
+
+/**
+ * omap_volt_data - Omap voltage specific data.
+ *
+ * @u_volt_nominal	: The possible voltage value in uVolts
+ * @u_volt_dyn_nominal	: The run time optimized nominal voltage for device.
+ *			  this dynamic nominal is the nominal voltage
+ *			  specialized for that device at that time.
+ * @u_volt_dyn_margin	: margin to add on top of calib voltage for this opp
+ * @u_volt_calib	: Calibrated voltage for this opp
+ * @sr_nvalue		: Smartreflex N target value at voltage <voltage>
+ * @sr_errminlimit	: Error min limit value for smartreflex. This value
+ *			  differs at differnet opp and thus is linked
+ *			  with voltage.
+ * @vp_errorgain	: Error gain value for the voltage processor. This
+ *			  field also differs according to the voltage/opp.
+ */
+//struct omap_volt_data {
+//	unsigned long	u_volt_nominal;
+//	unsigned long	u_volt_dyn_nominal;
+//	unsigned long	u_volt_dyn_margin;
+//	unsigned long	u_volt_calib;
+//	u32		sr_nvalue;
+//	u8		sr_errminlimit;
+//	u8		vp_errorgain;
+//	bool		abb;
+//	u32		sr_val;
+//	u32		sr_error;
+//};
+
+
+/* Safety limits: 800MHz - 1.7GHz for the top OPP. Values outside this
+ * range are likely typos and rejected to prevent hardware damage. The
+ * lower OPPs may go down to 100MHz, but every OPP has to stay strictly
+ * between its neighbours or the kernel's floor/ceil searches break. */
+#define MPU_RATE_MAX		1700000000
+#define MPU_RATE_MIN		800000000
+#define MPU_RATE_MIN_LOW	100000000
+
+/* Hardware safety limits: 1.0V - 1.425V (in microvolts).
+ * These are hardware constraints to prevent damage. */
+#define MPU_VOLT_MAX		1425000
+#define MPU_VOLT_MIN		1000000
+
+/* Same for the CORE domain: L3 runs at 100 or 200MHz on stock OPPs, and
+ * VDD2 sits between 0.95V and 1.2V. */
+#define L3_RATE_MAX		266000000
+#define L3_RATE_MIN		50000000
+#define CORE_VOLT_MAX		1250000
+#define CORE_VOLT_MIN		950000
+
+/* IVA2 runs at up to 800MHz on stock OPPs, its voltage is VDD1's. */
+#define DSP_RATE_MAX		1000000000
+#define DSP_RATE_MIN		50000000
+
+/**
+ * struct opp_domain - a voltage domain whose rail this module moves
+ * @name:	used in messages
+ * @vdd:	VDD1 or VDD2, also the id of its voltage processor
+ * @volt_min:	lowest voltage a request may set
+ * @volt_max:	highest voltage a request may set
+ */
+struct opp_domain {
+	const char *name;
+	int vdd;
+	unsigned long volt_min;
+	unsigned long volt_max;
+};
+
+static const struct opp_domain mpu_domain = {
+	.name		= "mpu",
+	.vdd		= VDD1,
+	.volt_min	= MPU_VOLT_MIN,
+	.volt_max	= MPU_VOLT_MAX,
+};
+
+static const struct opp_domain core_domain = {
+	.name		= "core",
+	.vdd		= VDD2,
+	.volt_min	= CORE_VOLT_MIN,
+	.volt_max	= CORE_VOLT_MAX,
+};
+
+static int opp_find_cpufreq_index(unsigned long rate)
+{
+	int i;
+
+	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		if (freq_table[i].frequency == rate / 1000)
+			return i;
+	}
+	return -1;
+}
+
+/* Index of the enabled entry closest to cur, -1 if there is none. Real
+ * clocks can be a few kHz away from the nominal OPP rate. */
+static int opp_find_closest(const struct opp_entry *opps, int count,
+			    unsigned long cur)
+{
+	unsigned long rate, diff, best_diff = ULONG_MAX;
+	int i, best = -1;
+
+	for (i = 0; i < count; i++) {
+		if (!opps[i].opp->enabled)
+			continue;
+		rate = opps[i].opp->rate;
+		diff = (cur > rate) ? cur - rate : rate - cur;
+		if (diff < best_diff) {
+			best_diff = diff;
+			best = i;
+		}
+	}
+	return best;
+}
+
+/* Index of the OPP the MPU is running at right now, -1 if unknown. */
+static int opp_find_active(void)
+{
+	return opp_find_closest(mpu_opps, opp_count, omap_getspeed_fp(0) * 1000UL);
+}
+
+/* Keep the cpufreq table in step with an edited OPP. Disabled OPPs are
+ * marked invalid so governors never pick them. */
+static void opp_sync_freq_table(struct opp_entry *e)
+{
+	if (e->cpufreq_index < 0)
+		return;
+	freq_table[e->cpufreq_index].frequency = e->opp->enabled ?
+		e->opp->rate / 1000 : CPUFREQ_ENTRY_INVALID;
+}
+
+/* Directly modify cpufreq structures to bypass normal locking mechanisms.
+ * This is necessary because we're overriding the normal frequency limits.
+ * The kernel's cpufreq subsystem would normally prevent this.
+ * The new limit is the highest OPP that is still enabled. */
+static void opp_sync_policy(void)
+{
+	unsigned int max_freq = 0;
+	int i;
+
+	for (i = 0; i < opp_count; i++) {
+		if (mpu_opps[i].opp->enabled)
+			max_freq = max_t(unsigned int, max_freq,
+					 mpu_opps[i].opp->rate / 1000);
+	}
+	if (!max_freq)
+		return;
+	policy->cpuinfo.max_freq = max_freq;
+	if (tune_pin_khz) {
+		policy->min = policy->user_policy.min = tune_pin_khz;
+		max_freq = tune_pin_khz;
+	}
+	if (thermal_cap_khz && max_freq > thermal_cap_khz)
+		max_freq = max(thermal_cap_khz, policy->min);
+	policy->max = policy->user_policy.max = max_freq;
+}
+
+/* Directly modify opp->rate. This updates the OPP structure that the
+ * kernel uses internally. The actual clock rate change happens through
+ * the cpufreq policy update at the end. This direct manipulation is
+ * necessary because normal APIs don't allow overclocking.
+ * NOTE: clk_set_rate_fp() is not used. The clock rate is actually
+ * controlled by the cpufreq subsystem, so directly setting it here
+ * might conflict. */
+static void opp_set_rate(struct opp_entry *e, unsigned long rate)
+{
+	e->opp->rate = rate;
+	opp_sync_freq_table(e);
+}
+
+static void opp_restore_vdata(struct omap_volt_data *vdata,
+			      const struct omap_volt_data *def)
+{
+	vdata->u_volt_calib = def->u_volt_calib;
+	vdata->u_volt_dyn_nominal = def->u_volt_dyn_nominal;
+	vdata->u_volt_dyn_margin = def->u_volt_dyn_margin;
+	vdata->sr_errminlimit = def->sr_errminlimit;
+	vdata->vp_errorgain = def->vp_errorgain;
+	vdata->sr_nvalue = def->sr_nvalue;
+}
+
+/* Move the domain's rail to the calibrated voltage in vdata.
+ * vdata_current must be a copy of the table entry taken before it was
+ * edited. Read the actual current voltage from the voltage processor.
+ * This is necessary because the volt_data structure might have
+ * stale calibration values, but the hardware has the real voltage. */
+static void opp_scale_voltage(const struct opp_domain *dom,
+			      struct omap_volt_data *vdata,
+			      struct omap_volt_data *vdata_current,
+			      struct opp_timing *timing)
+{
+	unsigned long u_volt_current = omap_voltageprocessor_get_voltage_fp(dom->vdd);
+	ktime_t start;
+
+	vdata_current->u_volt_calib = u_volt_current;
+	if (vdata->u_volt_calib != u_volt_current) {
+		/* Only scale voltage if it actually changed to avoid unnecessary operations. */
+		start = ktime_get();
+		omap_voltage_scale_fp(dom->vdd, vdata, vdata_current);
+		opp_timing_end(timing, OPP_PHASE_VSCALE, start);
+	}
+	/* Configure voltage controller for the new voltage level. */
+	start = ktime_get();
+	vc_setup_on_voltage_fp(dom->vdd, vdata->u_volt_calib);
+	opp_timing_end(timing, OPP_PHASE_VC_SETUP, start);
+}
+
+/*
+ * VDD1 voltage processor slew. The VP moves the rail in steps of up to
+ * VSTEPMAX PMIC codes going up and VSTEPMIN going down, and waits
+ * SMPSWAITTIME sys_clk cycles per code for the PMIC to follow. VLIMITTO's
+ * TIMEOUT is how long it waits for a move to complete before flagging
+ * an error. The kernel derives all of them from the PMIC data once at
+ * boot; here they can be changed at run time, so that large moves take
+ * fewer, larger steps.
+ *
+ * A wait shorter than one PMIC step at the PMIC's slew rate would let the
+ * VP run ahead of the regulator, so it is refused, as is a timeout too
+ * short for a move across the whole VLIMITTO range. VDDMIN and VDDMAX
+ * are the last line of defence against a bad voltage and stay read-only.
+ *
+ * The values are written to the registers and to vdd1->vp_reg, which the
+ * kernel reprograms the registers from. The registers are in the PRM
+ * global module; vdd1->ocp_mod is where VDD1's interrupt status is.
+ * The settle time of every rail move made by opp_transition() is kept
+ * from the last change on.
+ */
+#define SYS_CLK		"sys_ck"	/* VP timing reference */
+#define VP_STEP_MAX	0xFF		/* 8 bit step fields */
+#define VP_WAIT_MAX	0xFFFF		/* 16 bit wait and timeout fields */
+
+/**
+ * struct opp_vp_slew - the tunable VP fields
+ * @stepmin:	largest step down, in PMIC codes
+ * @stepmax:	largest step up, in PMIC codes
+ * @waitmin:	sys_clk cycles per code going down
+ * @waitmax:	sys_clk cycles per code going up
+ * @timeout:	sys_clk cycles a move may take
+ */
+struct opp_vp_slew {
+	u8 stepmin;
+	u8 stepmax;
+	u16 waitmin;
+	u16 waitmax;
+	u16 timeout;
+};
+
+static struct opp_vp_slew vp_default;
+static unsigned long vp_sys_khz;	/* 0 if sys_ck is missing */
+static unsigned int vp_settle_count;
+static u64 vp_settle_last_ns, vp_settle_max_ns;
+
+static void opp_vp_get(struct opp_vp_slew *s)
+{
+	struct vp_reg_val *r = &vdd1->vp_reg;
+
+	s->stepmin = r->vstepmin_stepmin;
+	s->stepmax = r->vstepmax_stepmax;
+	s->waitmin = r->vstepmin_smpswaittimemin;
+	s->waitmax = r->vstepmax_smpswaittimemax;
+	s->timeout = r->vlimitto_timeout;
+}
+
+/* What the VP registers hold right now */
+static void opp_vp_read(struct opp_vp_slew *s)
+{
+	struct vp_reg_val *r = &vdd1->vp_reg;
+	s16 mod = OMAP3430_GR_MOD;
+	u32 val;
+
+	val = prm_read_mod_reg_fp(mod, vdd1->vp_offs.vstepmin);
+	s->stepmin = (val >> r->vstepmin_stepmin_shift) & VP_STEP_MAX;
+	s->waitmin = (val >> r->vstepmin_smpswaittimemin_shift) & VP_WAIT_MAX;
+	val = prm_read_mod_reg_fp(mod, vdd1->vp_offs.vstepmax);
+	s->stepmax = (val >> r->vstepmax_stepmax_shift) & VP_STEP_MAX;
+	s->waitmax = (val >> r->vstepmax_smpswaittimemax_shift) & VP_WAIT_MAX;
+	val = prm_read_mod_reg_fp(mod, vdd1->vp_offs.vlimitto);
+	s->timeout = (val >> r->vlimitto_timeout_shift) & VP_WAIT_MAX;
+}
+
+/* Shortest wait per PMIC code the regulator can follow, in sys_clk cycles */
+static unsigned long opp_vp_wait_floor(void)
+{
+	struct omap_volt_pmic_info *pmic = vdd1->pmic;
+
+	if (!pmic || pmic->slew_rate <= 0 || pmic->step_size <= 0)
+		return 1;
+	return max(1UL, DIV_ROUND_UP(pmic->step_size * vp_sys_khz,
+				     pmic->slew_rate * 1000UL));
+}
+
+/* Write @s to vdd1->vp_reg and the VP registers. Caller holds
+ * VDD1's scaling_mutex, so no transition is moving the rail. */
+static void opp_vp_put(const struct opp_vp_slew *s)
+{
+	struct vp_reg_val *r = &vdd1->vp_reg;
+	s16 mod = OMAP3430_GR_MOD;
+
+	r->vstepmin_stepmin = s->stepmin;
+	r->vstepmax_stepmax = s->stepmax;
+	r->vstepmin_smpswaittimemin = s->waitmin;
+	r->vstepmax_smpswaittimemax = s->waitmax;
+	r->vlimitto_timeout = s->timeout;
+
+	prm_write_mod_reg_fp((r->vstepmin_smpswaittimemin << r->vstepmin_smpswaittimemin_shift) |
+			     (r->vstepmin_stepmin << r->vstepmin_stepmin_shift),
+			     mod, vdd1->vp_offs.vstepmin);
+	prm_write_mod_reg_fp((r->vstepmax_smpswaittimemax << r->vstepmax_smpswaittimemax_shift) |
+			     (r->vstepmax_stepmax << r->vstepmax_stepmax_shift),
+			     mod, vdd1->vp_offs.vstepmax);
+	prm_write_mod_reg_fp((r->vlimitto_vddmax << r->vlimitto_vddmax_shift) |
+			     (r->vlimitto_vddmin << r->vlimitto_vddmin_shift) |
+			     (r->vlimitto_timeout << r->vlimitto_timeout_shift),
+			     mod, vdd1->vp_offs.vlimitto);
+
+	vp_settle_count = 0;
+	vp_settle_last_ns = 0;
+	vp_settle_max_ns = 0;
+}
+
+/**
+ * opp_vp_set - change one VP slew field of VDD1
+ * @field:	"stepmin", "stepmax", "waitmin", "waitmax" or "timeout"
+ * @val:	new value, 0 returns the field to its load-time value
+ *
+ * The result is checked as a whole against the PMIC before anything is
+ * written, see the comment above.
+ */
+static int opp_vp_set(const char *field, unsigned long val)
+{
+	struct opp_vp_slew s;
+	unsigned long floor, range;
+
+	if (!vp_sys_khz)
+		return -ENODEV;
+
+	if (val > (!strncmp(field, "step", 4) ? VP_STEP_MAX : VP_WAIT_MAX))
+		return -ERANGE;
+	opp_vp_get(&s);
+	if (!strcmp(field, "stepmin"))
+		s.stepmin = val ? val : vp_default.stepmin;
+	else if (!strcmp(field, "stepmax"))
+		s.stepmax = val ? val : vp_default.stepmax;
+	else if (!strcmp(field, "waitmin"))
+		s.waitmin = val ? val : vp_default.waitmin;
+	else if (!strcmp(field, "waitmax"))
+		s.waitmax = val ? val : vp_default.waitmax;
+	else if (!strcmp(field, "timeout"))
+		s.timeout = val ? val : vp_default.timeout;
+	else
+		return -EINVAL;
+
+	if (!s.stepmin || !s.stepmax)
+		return -ERANGE;
+	floor = opp_vp_wait_floor();
+	if (s.waitmin < floor || s.waitmax < floor) {
+		printk(KERN_INFO "opptimizer: VP wait below the PMIC slew rate, %lu cycles at least\n",
+		       floor);
+		return -ERANGE;
+	}
+	range = vdd1->vp_reg.vlimitto_vddmax > vdd1->vp_reg.vlimitto_vddmin ?
+		vdd1->vp_reg.vlimitto_vddmax - vdd1->vp_reg.vlimitto_vddmin : 0;
+	if (s.timeout < range * max(s.waitmin, s.waitmax)) {
+		printk(KERN_INFO "opptimizer: VP timeout too short, %lu cycles at least\n",
+		       range * max(s.waitmin, s.waitmax));
+		return -ERANGE;
+	}
+
+	mutex_lock(&vdd1->scaling_mutex);
+	opp_vp_put(&s);
+	mutex_unlock(&vdd1->scaling_mutex);
+	printk(KERN_INFO "opptimizer: VP step %u/%u wait %u/%u timeout %u\n",
+	       s.stepmin, s.stepmax, s.waitmin, s.waitmax, s.timeout);
+	return 0;
+}
+
+/* Called with the timing of every MPU transition */
+static void opp_vp_settle(const struct opp_timing *t)
+{
+	u64 ns;
+
+	if (!(t->ran & (1 << OPP_PHASE_VSCALE)))
+		return;
+	ns = t->ns[OPP_PHASE_VSCALE];
+	vp_settle_last_ns = ns;
+	if (ns > vp_settle_max_ns)
+		vp_settle_max_ns = ns;
+	vp_settle_count++;
+}
+
+static void opp_vp_restore(void)
+{
+	struct opp_vp_slew s;
+
+	opp_vp_get(&s);
+	if (!vp_sys_khz || !memcmp(&s, &vp_default, sizeof(s)))
+		return;
+	mutex_lock(&vdd1->scaling_mutex);
+	opp_vp_put(&vp_default);
+	mutex_unlock(&vdd1->scaling_mutex);
+}
+
+static void opp_vp_init(void)
+{
+	struct clk *sys_clk;
+
+	opp_vp_get(&vp_default);
+	sys_clk = clk_get_fp(NULL, SYS_CLK);
+	if (IS_ERR(sys_clk)) {
+		printk(KERN_INFO "opptimizer: no %s, VP slew is read-only\n", SYS_CLK);
+		return;
+	}
+	vp_sys_khz = clk_get_rate_fp(sys_clk) / 1000;
+}
+
+/*
+ * VDD1 adaptive body bias. On the 3630 the ABB LDO can forward bias the
+ * MPU's transistors (FBB), which lets an OPP reach its rate at a lower
+ * voltage. The voltage table's abb flag says which OPPs use it and the
+ * kernel switches the LDO along with its own DVFS. Here the flag can be
+ * changed per OPP, and for the OPP the MPU runs at the LDO is switched
+ * by opp_xition_run() around the rail move, see there for the order.
+ *
+ * A switch selects the mode in PRM_LDO_ABB_SETUP, sets OPP_CHANGE and
+ * waits for ABB_LDO_TRANXDONE in PRM_IRQSTATUS_MPU. The offsets and the
+ * done bit come from vdd1->omap_abb_reg_val; a VDD without an ABB LDO
+ * has them all zero. The LDO only waits for the bias to settle if FBB
+ * and its wait count are set up in PRM_LDO_ABB_CTRL, which the kernel
+ * leaves alone when no OPP uses ABB at boot.
+ */
+#define ABB_OPP_SEL_MASK	(3 << 0)	/* PRM_LDO_ABB_SETUP */
+#define ABB_OPP_SEL_NOMINAL	0
+#define ABB_OPP_SEL_FAST	1
+#define ABB_OPP_CHANGE		(1 << 2)
+#define ABB_SR2EN		(1 << 0)	/* PRM_LDO_ABB_CTRL */
+#define ABB_ACTIVE_FBB_SEL	(1 << 2)
+#define ABB_WTCNT_SHIFT		8
+#define ABB_WTCNT_MASK		(0xFF << ABB_WTCNT_SHIFT)
+#define ABB_WTCNT_CYCLES	8	/* sys_clk cycles per wait count */
+#define ABB_SETTLE_US		30	/* bias settling time */
+#define ABB_TIMEOUT_US		100	/* for TRANXDONE */
+
+static bool abb_supported;
+static unsigned int abb_switches, abb_timeouts;
+static int abb_last_status = OPP_ABB_IDLE;
+
+/* Non-zero while the LDO forward biases VDD1 */
+static int opp_abb_fbb(void)
+{
+	struct abb_reg_val *r = &vdd1->omap_abb_reg_val;
+
+	if (!abb_supported)
+		return 0;
+	return (prm_read_mod_reg_fp(OMAP3430_GR_MOD, r->prm_abb_ldo_setup_idx) &
+		ABB_OPP_SEL_MASK) == ABB_OPP_SEL_FAST;
+}
+
+/* Enable FBB in the LDO and let it wait ABB_SETTLE_US per switch */
+static void opp_abb_setup(void)
+{
+	struct abb_reg_val *r = &vdd1->omap_abb_reg_val;
+	u32 val, wtcnt;
+
+	wtcnt = min(DIV_ROUND_UP(ABB_SETTLE_US * vp_sys_khz,
+				 1000UL * ABB_WTCNT_CYCLES), 0xFFUL);
+	val = prm_read_mod_reg_fp(OMAP3430_GR_MOD, r->prm_abb_ldo_ctrl_idx);
+	if ((val & (ABB_SR2EN | ABB_ACTIVE_FBB_SEL)) ==
+	    (ABB_SR2EN | ABB_ACTIVE_FBB_SEL) && (val & ABB_WTCNT_MASK))
+		return;
+	val &= ~ABB_WTCNT_MASK;
+	val |= ABB_SR2EN | ABB_ACTIVE_FBB_SEL | (wtcnt << ABB_WTCNT_SHIFT);
+	prm_write_mod_reg_fp(val, OMAP3430_GR_MOD, r->prm_abb_ldo_ctrl_idx);
+}
+
+/**
+ * opp_abb_switch - move the VDD1 ABB LDO to FBB or bypass
+ * @fbb:	non-zero for forward body bias
+ *
+ * Returns 0 once the LDO reports done, 1 if it was in that mode already
+ * and -ETIMEDOUT if it doesn't report done within ABB_TIMEOUT_US. Caller
+ * holds VDD1's scaling_mutex.
+ */
+static int opp_abb_switch(int fbb)
+{
+	struct abb_reg_val *r = &vdd1->omap_abb_reg_val;
+	s16 mod = vdd1->ocp_mod;
+	u32 val, done = r->abb_done_st_mask;
+	int us;
+
+	if (!!fbb == opp_abb_fbb())
+		return 1;
+	if (fbb)
+		opp_abb_setup();
+
+	/* A stale done bit would end the wait below at once */
+	prm_write_mod_reg_fp(done, mod, r->prm_irqstatus_mpu);
+	val = prm_read_mod_reg_fp(OMAP3430_GR_MOD, r->prm_abb_ldo_setup_idx);
+	val &= ~(ABB_OPP_SEL_MASK | ABB_OPP_CHANGE);
+	val |= fbb ? ABB_OPP_SEL_FAST : ABB_OPP_SEL_NOMINAL;
+	prm_write_mod_reg_fp(val, OMAP3430_GR_MOD, r->prm_abb_ldo_setup_idx);
+	prm_write_mod_reg_fp(val | ABB_OPP_CHANGE, OMAP3430_GR_MOD,
+			     r->prm_abb_ldo_setup_idx);
+	for (us = 0; us < ABB_TIMEOUT_US; us++) {
+		if (prm_read_mod_reg_fp(mod, r->prm_irqstatus_mpu) & done)
+			break;
+		udelay(1);
+	}
+	prm_write_mod_reg_fp(done, mod, r->prm_irqstatus_mpu);
+
+	abb_switches++;
+	if (us == ABB_TIMEOUT_US) {
+		abb_timeouts++;
+		abb_last_status = OPP_ABB_TIMEOUT;
+		printk(KERN_INFO "opptimizer: ABB LDO timed out going to %s\n",
+		       fbb ? "FBB" : "bypass");
+		return -ETIMEDOUT;
+	}
+	abb_last_status = OPP_ABB_DONE;
+	return 0;
+}
+
+/* Move the MPU rail to e->vdata, which the MPU runs at, with the LDO
+ * switched on the high side of the move like opp_xition_run() does.
+ * Returns 0 or the opp_abb_switch() error. If the switch ahead of a
+ * lower voltage fails the rail is left where it is, so body bias is
+ * never on below the voltage it was set up with. abb_status has the
+ * outcome either way. Caller holds VDD1's scaling_mutex. */
+static int opp_abb_scale_voltage(struct opp_entry *e,
+				 struct omap_volt_data *vdata_current)
+{
+	bool up = e->vdata->u_volt_calib > omap_voltageprocessor_get_voltage_fp(VDD1);
+	int ret = 0;
+
+	if (abb_supported && !up) {
+		ret = opp_abb_switch(e->vdata->abb);
+		if (ret < 0)
+			return ret;
+	}
+	opp_scale_voltage(&mpu_domain, e->vdata, vdata_current, NULL);
+	if (abb_supported && up)
+		ret = opp_abb_switch(e->vdata->abb);
+	return ret < 0 ? ret : 0;
+}
+
+static void opp_abb_init(void)
+{
+	struct abb_reg_val *r = &vdd1->omap_abb_reg_val;
+
+	abb_supported = r->prm_abb_ldo_setup_idx && r->prm_abb_ldo_ctrl_idx &&
+			r->prm_irqstatus_mpu && r->abb_done_st_mask && vp_sys_khz;
+	if (!abb_supported)
+		printk(KERN_INFO "opptimizer: no ABB LDO on VDD1\n");
+}
+
+/* Kernel side of struct opp_xition_ops. Only called with opp_mutex
+ * held, which also covers xition_vdata_current. */
+static struct omap_volt_data xition_vdata_current;
+
+static unsigned long opp_xition_get_rate(void *priv, int index)
+{
+	return mpu_opps[index].opp->rate;
+}
+
+static void opp_xition_set_rate(void *priv, int index, unsigned long rate)
+{
+	opp_set_rate(&mpu_opps[index], rate);
+}
+
+static int opp_xition_active_index(void *priv)
+{
+	return opp_find_active();
+}
+
+static void opp_xition_vdata_get(const struct omap_volt_data *vdata,
+				 struct opp_xition_vdata *v)
+{
+	v->u_volt_calib = vdata->u_volt_calib;
+	v->u_volt_dyn_nominal = vdata->u_volt_dyn_nominal;
+	v->u_volt_dyn_margin = vdata->u_volt_dyn_margin;
+	v->sr_errminlimit = vdata->sr_errminlimit;
+	v->vp_errorgain = vdata->vp_errorgain;
+	v->sr_nvalue = vdata->sr_nvalue;
+	v->abb = vdata->abb;
+}
+
+static void opp_xition_save_vdata(void *priv, int index, struct opp_xition_vdata *v)
+{
+	memcpy(&xition_vdata_current, mpu_opps[index].vdata,
+	       sizeof(xition_vdata_current));
+	opp_xition_vdata_get(&xition_vdata_current, v);
+}
+
+static void opp_xition_get_default_vdata(void *priv, int index,
+					 struct opp_xition_vdata *v)
+{
+	opp_xition_vdata_get(mpu_opps[index].default_vdata, v);
+}
+
+static void opp_xition_set_vdata(void *priv, int index,
+				 const struct opp_xition_vdata *v)
+{
+	struct omap_volt_data *vdata = mpu_opps[index].vdata;
+
+	vdata->u_volt_calib = v->u_volt_calib;
+	vdata->u_volt_dyn_nominal = v->u_volt_dyn_nominal;
+	vdata->u_volt_dyn_margin = v->u_volt_dyn_margin;
+	vdata->sr_errminlimit = v->sr_errminlimit;
+	vdata->vp_errorgain = v->vp_errorgain;
+	vdata->sr_nvalue = v->sr_nvalue;
+	vdata->abb = v->abb;
+}
+
+static unsigned long opp_xition_vp_voltage(void *priv)
+{
+	return omap_voltageprocessor_get_voltage_fp(mpu_domain.vdd);
+}
+
+static void opp_xition_scale_voltage(void *priv, int index,
+				     unsigned long u_volt_current)
+{
+	xition_vdata_current.u_volt_calib = u_volt_current;
+	omap_voltage_scale_fp(mpu_domain.vdd, mpu_opps[index].vdata,
+			      &xition_vdata_current);
+}
+
+static void opp_xition_vc_setup(void *priv, unsigned long u_volt)
+{
+	vc_setup_on_voltage_fp(mpu_domain.vdd, u_volt);
+}
+
+static void opp_xition_lock(void *priv)
+{
+	mutex_lock(&vdd1->scaling_mutex);
+}
+
+static void opp_xition_unlock(void *priv)
+{
+	mutex_unlock(&vdd1->scaling_mutex);
+}
+
+static void opp_xition_sync_policy(void *priv)
+{
+	opp_sync_policy();
+}
+
+static void opp_xition_sr_recal(void *priv)
+{
+	sr_class1p5_reset_calib_fp(mpu_domain.vdd, true, true);
+}
+
+/* NOTE: cpufreq_stats (frequency statistics) may be inaccurate after
+ * this, its table still has the old rates. /proc/opptimizer_time_in_state
+ * is kept by rate instead, opp_transition() tells it in case the clock
+ * moved without a cpufreq transition. */
+static void opp_xition_update_policy(void *priv)
+{
+	cpufreq_update_policy_fp(0);
+}
+
+static u64 opp_xition_now_ns(void *priv)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+static void opp_xition_notice(void *priv, const char *msg)
+{
+	printk(KERN_INFO "opptimizer: %s\n", msg);
+}
+
+/* SmartReflex values pinned per MPU OPP by OPP_TX_SR requests */
+static struct opp_xition_vdata sr_pins[OPP_MAX_COUNT];
+static bool sr_pinned[OPP_MAX_COUNT];
+
+static int opp_xition_sr_pinned(void *priv, int index, struct opp_xition_vdata *v)
+{
+	if (sr_pinned[index])
+		*v = sr_pins[index];
+	return sr_pinned[index];
+}
+
+static void opp_xition_sr_pin(void *priv, int index, const struct opp_xition_vdata *v)
+{
+	sr_pinned[index] = v != NULL;
+	if (v)
+		sr_pins[index] = *v;
+}
+
+static int opp_xition_abb_switch(void *priv, int fbb)
+{
+	return opp_abb_switch(fbb);
+}
+
+static const struct opp_xition_ops opp_xition_kernel_ops = {
+	.get_rate		= opp_xition_get_rate,
+	.set_rate		= opp_xition_set_rate,
+	.active_index		= opp_xition_active_index,
+	.save_vdata		= opp_xition_save_vdata,
+	.get_default_vdata	= opp_xition_get_default_vdata,
+	.set_vdata		= opp_xition_set_vdata,
+	.vp_voltage		= opp_xition_vp_voltage,
+	.scale_voltage		= opp_xition_scale_voltage,
+	.vc_setup		= opp_xition_vc_setup,
+	.lock			= opp_xition_lock,
+	.unlock			= opp_xition_unlock,
+	.sync_policy		= opp_xition_sync_policy,
+	.sr_recal		= opp_xition_sr_recal,
+	.update_policy		= opp_xition_update_policy,
+	.now_ns			= opp_xition_now_ns,
+	.notice			= opp_xition_notice,
+	.sr_pinned		= opp_xition_sr_pinned,
+	.sr_pin			= opp_xition_sr_pin,
+	.abb_switch		= opp_xition_abb_switch,
+};
+
+static void opp_xition_limits(struct opp_xition_limits *lim)
+{
+	lim->count = opp_count;
+	lim->rate_min = MPU_RATE_MIN;
+	lim->rate_min_low = MPU_RATE_MIN_LOW;
+	lim->rate_max = MPU_RATE_MAX;
+	lim->volt_min = mpu_domain.volt_min;
+	lim->volt_max = mpu_domain.volt_max;
+}
+
+static int opp_check_rate(int index, unsigned long rate)
+{
+	struct opp_xition_limits lim;
+
+	opp_xition_limits(&lim);
+	return opp_xition_check_rate(&opp_xition_kernel_ops, NULL, &lim, index, rate);
+}
+
+/**
+ * opp_transition - change the rate, voltage and SmartReflex setup of one MPU OPP
+ * @tx:	the request, see struct opp_ioc_transition. On success the reply
+ *	fields are filled in.
+ *
+ * The sequence itself is opp_xition_run(), which also builds on a host
+ * (see oppsim.c). The statistics are kept here.
+ */
+static int opp_transition(struct opp_ioc_transition *tx)
+{
+	struct opp_xition_limits lim;
+	struct opp_timing timing;
+	unsigned int old_khz = omap_getspeed_fp(0);
+	int ret;
+
+	if ((tx->flags & OPP_TX_ABB) && !abb_supported)
+		return -ENODEV;
+	opp_xition_limits(&lim);
+	ret = opp_xition_run(&opp_xition_kernel_ops, NULL, &lim, tx, &timing);
+	if (ret)
+		return ret;
+
+	opp_stats_update(omap_getspeed_fp(0));
+	opp_latency_record(old_khz, omap_getspeed_fp(0), &timing);
+	opp_vp_settle(&timing);
+	return 0;
+}
+
+/* Enable or disable one MPU OPP. The last enabled OPP can't be disabled,
+ * cpufreq would be left without a single valid frequency. */
+static int opp_set_enabled(int index, bool enable)
+{
+	struct opp_entry *e = &mpu_opps[index];
+	int ret;
+
+	if (e->opp->enabled == enable)
+		return 0;
+	if (!enable && enabled_opp_count <= 1)
+		return -EBUSY;
+
+	mutex_lock(&vdd1->scaling_mutex);
+	ret = enable ? opp_enable_fp(e->opp) : opp_disable_fp(e->opp);
+	if (ret) {
+		mutex_unlock(&vdd1->scaling_mutex);
+		printk(KERN_ERR "opptimizer: could not %s OPP%d (%d)\n",
+		       enable ? "enable" : "disable", index, ret);
+		return ret;
+	}
+	enabled_opp_count += enable ? 1 : -1;
+	opp_sync_freq_table(e);
+	opp_sync_policy();
+	mutex_unlock(&vdd1->scaling_mutex);
+	cpufreq_update_policy_fp(0);
+	printk(KERN_INFO "opptimizer: OPP%d %s\n", index, enable ? "enabled" : "disabled");
+	return 0;
+}
+
+/**
+ * opp_vdata_set - change one field of one VDD1 voltage table entry
+ * @index:	entry in vdd1->volt_data[]
+ * @field:	"calib", "dyn_nominal" or "dyn_margin"
+ * @u_volt:	new value, 0 returns the field to its load-time value
+ *
+ * Voltages are clamped like every other request, and the margin may
+ * not take the calibrated voltage over the ceiling. If VDD1 is sitting
+ * at this entry right now the rail is moved and SmartReflex restarted,
+ * otherwise the kernel picks the value up on its next transition.
+ */
+static int opp_vdata_set(int index, const char *field, unsigned long u_volt)
+{
+	struct omap_volt_data *vdata, *def, vdata_current;
+	unsigned long *val;
+	bool active;
+
+	if (index < 0 || index >= vdata_count)
+		return -EINVAL;
+	vdata = &vdd1->volt_data[index];
+	def = &vdata_defaults[index];
+
+	if (!strcmp(field, "calib")) {
+		val = &vdata->u_volt_calib;
+		if (!u_volt)
+			u_volt = def->u_volt_calib;
+	} else if (!strcmp(field, "dyn_nominal")) {
+		val = &vdata->u_volt_dyn_nominal;
+		if (!u_volt)
+			u_volt = def->u_volt_dyn_nominal;
+	} else if (!strcmp(field, "dyn_margin")) {
+		val = &vdata->u_volt_dyn_margin;
+		if (!u_volt)
+			u_volt = def->u_volt_dyn_margin;
+	} else
+		return -EINVAL;
+
+	mutex_lock(&vdd1->scaling_mutex);
+	if (val == &vdata->u_volt_dyn_margin)
+		u_volt = vdata->u_volt_calib >= MPU_VOLT_MAX ? 0 :
+			 min_t(unsigned long, u_volt, MPU_VOLT_MAX - vdata->u_volt_calib);
+	else
+		u_volt = clamp_t(unsigned long, u_volt, MPU_VOLT_MIN, MPU_VOLT_MAX);
+	active = (vdd1->curr_volt == vdata);
+	memcpy(&vdata_current, vdata, sizeof(vdata_current));
+	*val = u_volt;
+	if (active)
+		opp_scale_voltage(&mpu_domain, vdata, &vdata_current, NULL);
+	mutex_unlock(&vdd1->scaling_mutex);
+	if (active)
+		sr_class1p5_reset_calib_fp(VDD1, true, true);
+	printk(KERN_INFO "opptimizer: VDATA%d %s set to %lu\n", index, field, u_volt);
+	return 0;
+}
+
+/* Put back every voltage table entry that still differs from its
+ * load-time copy. Caller holds opp_mutex. */
+static void opp_vdata_restore_all(void)
+{
+	struct omap_volt_data *vdata, vdata_current;
+	bool active;
+	int i;
+
+	mutex_lock(&vdd1->scaling_mutex);
+	for (i = 0; i < vdata_count; i++) {
+		vdata = &vdd1->volt_data[i];
+		memcpy(&vdata_current, vdata, sizeof(vdata_current));
+		opp_restore_vdata(vdata, &vdata_defaults[i]);
+		if (!memcmp(&vdata_current, vdata, sizeof(vdata_current)))
+			continue;
+		active = (vdd1->curr_volt == vdata);
+		if (active)
+			opp_scale_voltage(&mpu_domain, vdata, &vdata_current, NULL);
+	}
+	mutex_unlock(&vdd1->scaling_mutex);
+}
+
+/*
+ * Secondary OPP tables: L3 on the CORE domain and the IVA2 DSP, which
+ * shares VDD1 with the MPU. Each is kept in the same top-down order as
+ * mpu_opps[] and changed with the same rules as opp_transition(): the
+ * voltage goes up before the clock and down after it, the rail only
+ * moves when it sits at the edited entry, and the clock only moves when
+ * it runs at the edited OPP. Otherwise the kernel's own DVFS picks the
+ * new values up on its next switch.
+ *
+ * L3 runs at a fixed divider of DPLL3's M2 output, which also clocks
+ * the SDRAM controller, so its rate is changed on dpll3_m2_ck the way
+ * the kernel's VDD2 DVFS does it, and memory bandwidth scales with it.
+ * cpufreq never moves L3, so an MPU OPP can be linked to an L3 OPP and
+ * every MPU transition then pulls the L3 along (see opp_cpufreq_notify()).
+ *
+ * A DSP voltage is a VDD1 table entry, shared with the MPU OPP of the
+ * same nominal voltage, so changing it changes that MPU OPP too.
+ *
+ * Both tables are optional: when a clock or the OPPs can't be found the
+ * table stays empty and its commands return -ENODEV.
+ */
+#define L3_CLK		"l3_ick"
+#define CORE_CLK	"dpll3_m2_ck"	/* L3 and SDRC parent */
+#define DSP_CLK		"iva2_ck"
+
+/**
+ * struct opp_table - OPPs of one clock outside cpufreq
+ * @name:		used in messages
+ * @dom:		voltage domain the OPPs live on
+ * @opp_type:		which OPP list to walk
+ * @clk_name:		clock that runs at the OPP rate
+ * @set_clk_name:	clock that is set, a fixed multiple of @clk_name
+ * @rate_min:		lowest rate an OPP may be set to
+ * @rate_max:		highest rate an OPP may be set to
+ * @vdd:		kernel state of @dom, for its scaling_mutex
+ * @clk:		looked up from @clk_name
+ * @set_clk:		looked up from @set_clk_name
+ * @div:		@set_clk rate / @clk rate, measured at load
+ * @opps:		the OPPs, highest first
+ * @vdata_defaults:	load-time copy of each entry's voltage data
+ * @count:		entries in @opps, 0 if the table is unavailable
+ */
+struct opp_table {
+	const char *name;
+	const struct opp_domain *dom;
+	enum opp_t opp_type;
+	const char *clk_name;
+	const char *set_clk_name;
+	unsigned long rate_min;
+	unsigned long rate_max;
+
+	struct omap_vdd_info *vdd;
+	struct clk *clk, *set_clk;
+	unsigned long div;
+	struct opp_entry opps[OPP_MAX_COUNT];
+	struct omap_volt_data vdata_defaults[OPP_MAX_COUNT];
+	int count;
+};
+
+static struct opp_table l3_table = {
+	.name		= "L3",
+	.dom		= &core_domain,
+	.opp_type	= OPP_L3,
+	.clk_name	= L3_CLK,
+	.set_clk_name	= CORE_CLK,
+	.rate_min	= L3_RATE_MIN,
+	.rate_max	= L3_RATE_MAX,
+};
+
+static struct opp_table dsp_table = {
+	.name		= "DSP",
+	.dom		= &mpu_domain,
+	.opp_type	= OPP_DSP,
+	.clk_name	= DSP_CLK,
+	.set_clk_name	= DSP_CLK,
+	.rate_min	= DSP_RATE_MIN,
+	.rate_max	= DSP_RATE_MAX,
+};
+
+/* L3 OPP each MPU OPP pulls along, -1 for none. Written under
+ * opp_mutex, read by the cpufreq notifier without it. */
+static int l3_link[OPP_MAX_COUNT];
+static int l3_follow_target = -1;
+static struct work_struct l3_follow_work;
+
+static int opp_table_find_active(struct opp_table *t)
+{
+	return opp_find_closest(t->opps, t->count, clk_get_rate_fp(t->clk));
+}
+
+static int opp_table_set_clk(struct opp_table *t, unsigned long rate)
+{
+	long set_rate = clk_round_rate_fp(t->set_clk, rate * t->div);
+	int ret;
+
+	if (set_rate <= 0)
+		return -EINVAL;
+	ret = clk_set_rate_fp(t->set_clk, set_rate);
+	if (ret)
+		printk(KERN_ERR "opptimizer: could not set %s to %luhz (%d)\n",
+		       t->name, rate, ret);
+	return ret;
+}
+
+static int opp_table_check_rate(struct opp_table *t, int index, unsigned long rate)
+{
+	if (rate > t->rate_max || rate < t->rate_min) {
+		printk(KERN_INFO "opptimizer: %s rate too high or low!\n", t->name);
+		return -ERANGE;
+	}
+	if ((index > 0 && rate >= t->opps[index - 1].opp->rate) ||
+	    (index < t->count - 1 && rate <= t->opps[index + 1].opp->rate)) {
+		printk(KERN_INFO "opptimizer: %s OPP%d must stay between its neighbours!\n",
+		       t->name, index);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* Change the rate and calibrated voltage of one OPP of @t, u_volt 0
+ * returns to the default voltage. Caller holds opp_mutex. */
+static int opp_table_edit(struct opp_table *t, int index, unsigned long rate,
+			  unsigned long u_volt)
+{
+	struct opp_entry *e;
+	struct omap_volt_data vdata_current;
+	unsigned long old_rate;
+	bool clk_active, rail_active;
+	int ret = 0;
+
+	if (!t->count)
+		return -ENODEV;
+	if (index < 0 || index >= t->count)
+		return -EINVAL;
+	e = &t->opps[index];
+	old_rate = e->opp->rate;
+	if (rate != old_rate) {
+		ret = opp_table_check_rate(t, index, rate);
+		if (ret)
+			return ret;
+	}
+	if (u_volt)
+		u_volt = clamp_t(unsigned long, u_volt, t->dom->volt_min,
+				 t->dom->volt_max);
+
+	mutex_lock(&t->vdd->scaling_mutex);
+	clk_active = (opp_table_find_active(t) == index);
+	rail_active = (t->vdd->curr_volt == e->vdata);
+	memcpy(&vdata_current, e->vdata, sizeof(vdata_current));
+	if (rate < old_rate) {
+		e->opp->rate = rate;
+		if (clk_active)
+			ret = opp_table_set_clk(t, rate);
+		/* The clock is still at the old rate, the rail has to stay
+		 * where it is for it */
+		if (ret) {
+			e->opp->rate = old_rate;
+			mutex_unlock(&t->vdd->scaling_mutex);
+			return ret;
+		}
+	}
+	if (u_volt) {
+		e->vdata->u_volt_calib = u_volt;
+		e->vdata->u_volt_dyn_nominal = u_volt;
+		e->vdata->u_volt_dyn_margin = 0;
+	} else
+		opp_restore_vdata(e->vdata, e->default_vdata);
+	if (rail_active)
+		opp_scale_voltage(t->dom, e->vdata, &vdata_current, NULL);
+	if (rate > old_rate) {
+		e->opp->rate = rate;
+		if (clk_active)
+			ret = opp_table_set_clk(t, rate);
+		if (ret)
+			e->opp->rate = old_rate;
+	}
+	mutex_unlock(&t->vdd->scaling_mutex);
+	if (rail_active)
+		sr_class1p5_reset_calib_fp(t->dom->vdd, true, true);
+	if (rate != old_rate)
+		printk(KERN_INFO "opptimizer: updated %s OPP%d rate to %lumhz\n",
+		       t->name, index, rate / 1000000);
+	return ret;
+}
+
+/* Move the clock of @t and its rail from wherever they are to OPP
+ * @target. Only used for L3, whose rail nothing else shares. Caller
+ * holds opp_mutex. */
+static int opp_table_switch(struct opp_table *t, int target)
+{
+	struct opp_entry *e = &t->opps[target];
+	struct omap_volt_data vdata_current;
+	unsigned long cur_rate;
+	int ret = 0;
+
+	mutex_lock(&t->vdd->scaling_mutex);
+	cur_rate = clk_get_rate_fp(t->clk);
+	if (opp_table_find_active(t) == target) {
+		mutex_unlock(&t->vdd->scaling_mutex);
+		return 0;
+	}
+	memcpy(&vdata_current, t->vdd->curr_volt, sizeof(vdata_current));
+	if (e->opp->rate > cur_rate) {
+		opp_scale_voltage(t->dom, e->vdata, &vdata_current, NULL);
+		ret = opp_table_set_clk(t, e->opp->rate);
+	} else {
+		ret = opp_table_set_clk(t, e->opp->rate);
+		/* Still at the higher rate, keep the rail for it */
+		if (ret) {
+			mutex_unlock(&t->vdd->scaling_mutex);
+			return ret;
+		}
+		opp_scale_voltage(t->dom, e->vdata, &vdata_current, NULL);
+	}
+	mutex_unlock(&t->vdd->scaling_mutex);
+	sr_class1p5_reset_calib_fp(t->dom->vdd, true, true);
+	return ret;
+}
+
+static void opp_l3_follow(struct work_struct *work)
+{
+	int target;
+
+	mutex_lock(&opp_mutex);
+	target = ACCESS_ONCE(l3_follow_target);
+	if (target >= 0 && target < l3_table.count)
+		opp_table_switch(&l3_table, target);
+	mutex_unlock(&opp_mutex);
+}
+
+/* Every MPU rate change is counted for the time-in-state stats and pulls
+ * the linked L3 OPP along. Runs inside the cpufreq transition, where
+ * neither opp_mutex nor the scaling_mutex may be taken, so the L3 switch
+ * itself is left to a work item. */
+static int opp_cpufreq_notify(struct notifier_block *nb, unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+	int index, target;
+
+	if (val != CPUFREQ_POSTCHANGE || freqs->cpu)
+		return NOTIFY_OK;
+	opp_stats_update(freqs->new);
+	if (!l3_table.count)
+		return NOTIFY_OK;
+	index = opp_find_closest(mpu_opps, opp_count, freqs->new * 1000UL);
+	if (index < 0)
+		return NOTIFY_OK;
+	target = ACCESS_ONCE(l3_link[index]);
+	if (target >= 0) {
+		l3_follow_target = target;
+		schedule_work(&l3_follow_work);
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block opp_cpufreq_nb = {
+	.notifier_call	= opp_cpufreq_notify,
+};
+
+/* Link MPU OPP @index to L3 OPP @l3, -1 unlinks. If the MPU is at that
+ * OPP already the L3 moves right away. Caller holds opp_mutex. */
+static int opp_l3_link(int index, int l3)
+{
+	if (!l3_table.count)
+		return -ENODEV;
+	if (index < 0 || index >= opp_count || l3 < -1 || l3 >= l3_table.count)
+		return -EINVAL;
+	l3_link[index] = l3;
+	if (l3 >= 0 && opp_find_active() == index)
+		return opp_table_switch(&l3_table, l3);
+	return 0;
+}
+
+/* Look up the clocks and OPPs of @t. @vdds is the kernel's vdd_info
+ * array. Failing leaves the table empty, it is never fatal. */
+static void opp_table_init(struct opp_table *t, struct omap_vdd_info *vdds)
+{
+	unsigned long freq = ULONG_MAX, rate;
+	struct omap_volt_data *volt_data;
+	struct omap_opp *opp;
+	struct opp_entry *e;
+
+	t->vdd = vdds + t->dom->vdd;
+	t->clk = clk_get_fp(NULL, t->clk_name);
+	t->set_clk = clk_get_fp(NULL, t->set_clk_name);
+	if (IS_ERR(t->clk) || IS_ERR(t->set_clk) || !t->vdd->curr_volt)
+		goto unavailable;
+	rate = clk_get_rate_fp(t->clk);
+	t->div = rate ? clk_get_rate_fp(t->set_clk) / rate : 0;
+	if (!t->div)
+		goto unavailable;
+
+	while (t->count < OPP_MAX_COUNT) {
+		opp = opp_find_freq_floor_fp(t->opp_type, &freq);
+		if (!opp || IS_ERR(opp))
+			break;
+		volt_data = omap_get_volt_data_fp(t->dom->vdd, opp_get_voltage_fp(opp));
+		if (!volt_data)
+			goto unavailable;
+
+		e = &t->opps[t->count];
+		e->opp = opp;
+		e->vdata = volt_data;
+		e->cpufreq_index = -1;
+		e->default_rate = opp->rate;
+		e->default_enabled = opp->enabled;
+		memcpy(&t->vdata_defaults[t->count], volt_data, sizeof(*volt_data));
+		e->default_vdata = &t->vdata_defaults[t->count];
+		t->count++;
+
+		freq = opp->rate - 1;
+	}
+	if (!t->count)
+		goto unavailable;
+	printk(KERN_INFO "opptimizer: managing %d %s OPPs, %s at %luhz\n",
+	       t->count, t->name, t->clk_name, rate);
+	return;
+
+unavailable:
+	t->count = 0;
+	printk(KERN_INFO "opptimizer: %s OPPs unavailable, %s scaling off\n",
+	       t->name, t->name);
+}
+
+/* Put every OPP of @t back to its load-time rate and voltage. Caller
+ * holds opp_mutex. */
+static void opp_table_restore(struct opp_table *t)
+{
+	struct omap_volt_data vdata_current;
+	struct opp_entry *e;
+	int i, active;
+	bool up, rail_active, rail_moved = false;
+
+	if (!t->count)
+		return;
+	mutex_lock(&t->vdd->scaling_mutex);
+	active = opp_table_find_active(t);
+	for (i = 0; i < t->count; i++) {
+		e = &t->opps[i];
+		up = e->default_rate > e->opp->rate;
+		rail_active = (t->vdd->curr_volt == e->vdata);
+		memcpy(&vdata_current, e->vdata, sizeof(vdata_current));
+		e->opp->rate = e->default_rate;
+		if (i == active && !up)
+			opp_table_set_clk(t, e->default_rate);
+		opp_restore_vdata(e->vdata, e->default_vdata);
+		if (rail_active && memcmp(&vdata_current, e->vdata, sizeof(vdata_current))) {
+			opp_scale_voltage(t->dom, e->vdata, &vdata_current, NULL);
+			rail_moved = true;
+		}
+		if (i == active && up)
+			opp_table_set_clk(t, e->default_rate);
+	}
+	mutex_unlock(&t->vdd->scaling_mutex);
+	if (rail_moved)
+		sr_class1p5_reset_calib_fp(t->dom->vdd, true, true);
+}
+
+/*
+ * Undervolt tuner. One search at a time runs in its own kthread: the
+ * OPP is moved to the rate under test, cpufreq is pinned there and
+ * opp_tune_run() walks the voltage down, running the workloads from
+ * opp_tune.c at every step. The outcome of the last search per rate is
+ * kept in tune_profile[] and shown by /proc/opptimizer_tune.
+ * While a search runs every other request that changes an OPP gets
+ * -EBUSY. tune_task and tune_profile[] are protected by opp_mutex.
+ *
+ * tune_task only says a search is running. The thread clears it before
+ * putting cpufreq back and freeing its buffer, so it is only gone once
+ * tune_done completes; tune_started says there is such a thread to wait
+ * for.
+ */
+#define TUNE_MEM_SIZE		(512 * 1024)	/* twice the L2 cache */
+#define TUNE_CPU_ROUNDS		(1 << 18)
+#define TUNE_PASSES		16		/* workload runs per voltage step */
+#define TUNE_SEED		0x5EED0123
+#define TUNE_TIMEOUT_FACTOR	4		/* slower than this many reference runs = hung */
+
+struct opp_tune_ctx {
+	int index;
+	unsigned long rate;
+	u32 *mem;
+	struct opp_tune_ref ref;
+	s64 budget_ns;
+};
+
+struct opp_tune_profile {
+	unsigned long rate;
+	struct opp_tune_result r;
+};
+
+static struct opp_tune_ctx tune_ctx;
+static struct task_struct *tune_task;
+static DECLARE_COMPLETION(tune_done);
+static bool tune_started;
+static int tune_abort;
+static unsigned long tune_cur_uv;
+static struct opp_tune_profile tune_profile[OPP_MAX_COUNT];
+static int tune_profile_count;
+
+static int opp_tune_set_voltage(void *priv, unsigned long u_volt)
+{
+	struct opp_tune_ctx *ctx = priv;
+	struct opp_ioc_transition tx;
+	int ret;
+
+	memset(&tx, 0, sizeof(tx));
+	tx.flags = OPP_TX_VOLT;
+	tx.index = ctx->index;
+	tx.u_volt = u_volt;
+	mutex_lock(&opp_mutex);
+	ret = opp_transition(&tx);
+	if (!ret && tx.clamped)
+		ret = -ERANGE;
+	tune_cur_uv = u_volt;
+	mutex_unlock(&opp_mutex);
+	return ret;
+}
+
+static int opp_tune_verify(void *priv)
+{
+	struct opp_tune_ctx *ctx = priv;
+	ktime_t start = ktime_get();
+	int i;
+
+	for (i = 0; i < TUNE_PASSES; i++) {
+		if (opp_tune_ref_check(&ctx->ref))
+			return -EIO;
+		cond_resched();
+	}
+	if (ktime_to_ns(ktime_sub(ktime_get(), start)) > ctx->budget_ns)
+		return -ETIMEDOUT;
+	return 0;
+}
+
+static int opp_tune_should_stop(void *priv)
+{
+	return ACCESS_ONCE(tune_abort) || kthread_should_stop();
+}
+
+static const struct opp_tune_ops opp_tune_kernel_ops = {
+	.set_voltage	= opp_tune_set_voltage,
+	.verify		= opp_tune_verify,
+	.should_stop	= opp_tune_should_stop,
+};
+
+/* Keep the latest result per rate, the oldest entry makes room. */
+static void opp_tune_store(unsigned long rate, const struct opp_tune_result *r)
+{
+	int i;
+
+	for (i = 0; i < tune_profile_count; i++) {
+		if (tune_profile[i].rate == rate)
+			break;
+	}
+	if (i == OPP_MAX_COUNT) {
+		memmove(&tune_profile[0], &tune_profile[1],
+			sizeof(tune_profile[0]) * (OPP_MAX_COUNT - 1));
+		i = OPP_MAX_COUNT - 1;
+	} else if (i == tune_profile_count)
+		tune_profile_count++;
+	tune_profile[i].rate = rate;
+	tune_profile[i].r = *r;
+}
+
+static int opp_tune_thread(void *data)
+{
+	struct opp_tune_ctx *ctx = data;
+	struct opp_tune_params p;
+	struct opp_tune_result r;
+	struct opp_ioc_transition tx;
+	unsigned int saved_min = 0;
+	ktime_t start;
+	int ret;
+
+	/* Move the OPP to the rate under test and pin cpufreq to it, so
+	 * the rail follows every voltage step below. */
+	memset(&tx, 0, sizeof(tx));
+	tx.flags = OPP_TX_RATE;
+	tx.index = ctx->index;
+	tx.rate = ctx->rate;
+	mutex_lock(&opp_mutex);
+	ret = opp_transition(&tx);
+	if (!ret) {
+		saved_min = policy->user_policy.min;
+		tune_pin_khz = ctx->rate / 1000;
+		opp_sync_policy();
+	}
+	mutex_unlock(&opp_mutex);
+	if (!ret) {
+		cpufreq_update_policy_fp(0);
+		if (opp_find_active() != ctx->index)
+			ret = -EAGAIN;
+	}
+
+	if (!ret) {
+		opp_tune_init_params(&p, mpu_opps[ctx->index].vdata->u_volt_calib,
+				     MPU_VOLT_MIN, MPU_VOLT_MAX);
+
+		/* The reference checksums come from the starting voltage,
+		 * which is known to be good. */
+		start = ktime_get();
+		opp_tune_ref_init(&ctx->ref, ctx->mem, TUNE_MEM_SIZE / sizeof(u32),
+				  TUNE_SEED, TUNE_CPU_ROUNDS);
+		ctx->budget_ns = ktime_to_ns(ktime_sub(ktime_get(), start)) *
+				 TUNE_PASSES * TUNE_TIMEOUT_FACTOR;
+
+		opp_tune_run(&opp_tune_kernel_ops, ctx, &p, &r);
+	} else {
+		memset(&r, 0, sizeof(r));
+		r.status = OPP_TUNE_ERROR;
+		r.error = ret;
+	}
+
+	mutex_lock(&opp_mutex);
+	opp_tune_store(ctx->rate, &r);
+	if (tune_pin_khz) {
+		tune_pin_khz = 0;
+		policy->min = policy->user_policy.min = saved_min;
+		opp_sync_policy();
+	}
+	tune_task = NULL;
+	mutex_unlock(&opp_mutex);
+	cpufreq_update_policy_fp(0);
+	vfree(ctx->mem);
+
+	printk(KERN_INFO "opptimizer: tune OPP%d %lumhz: %s, min stable %lu, left at %lu\n",
+	       ctx->index, ctx->rate / 1000000, opp_tune_status_name(r.status),
+	       r.min_stable_uv, r.applied_uv);
+	complete_and_exit(&tune_done, 0);
+}
+
+/* Wait for the tuner thread to exit. The completion is handed on, so
+ * every caller gets through until the next thread is started. The thread
+ * never takes opp_mutex after its search, this may run under it. */
+static void opp_tune_wait(void)
+{
+	wait_for_completion(&tune_done);
+	complete(&tune_done);
+}
+
+/* Caller holds opp_mutex. A rate of 0 tunes the OPP at its current rate. */
+static int opp_tune_start(int index, unsigned long rate)
+{
+	struct task_struct *task;
+	int ret;
+
+	if (tune_task)
+		return -EBUSY;
+	/* The last thread may still be freeing tune_ctx.mem */
+	if (tune_started)
+		opp_tune_wait();
+	tune_started = false;
+	if (index < 0 || index >= opp_count || !mpu_opps[index].opp->enabled)
+		return -EINVAL;
+	if (!rate)
+		rate = mpu_opps[index].opp->rate;
+	if (rate != mpu_opps[index].opp->rate) {
+		ret = opp_check_rate(index, rate);
+		if (ret)
+			return ret;
+	}
+
+	tune_ctx.index = index;
+	tune_ctx.rate = rate;
+	tune_ctx.mem = vmalloc(TUNE_MEM_SIZE);
+	if (!tune_ctx.mem)
+		return -ENOMEM;
+	tune_abort = 0;
+	tune_cur_uv = 0;
+	INIT_COMPLETION(tune_done);
+	task = kthread_run(opp_tune_thread, &tune_ctx, "opptimizer-tune");
+	if (IS_ERR(task)) {
+		vfree(tune_ctx.mem);
+		return PTR_ERR(task);
+	}
+	tune_task = task;
+	tune_started = true;
+	return 0;
+}
+
+/* Abort a running search and wait for its thread to exit, which also
+ * covers one that finished its search but is still on its way out. */
+static void opp_tune_stop(void)
+{
+	bool started;
+
+	mutex_lock(&opp_mutex);
+	started = tune_started;
+	tune_abort = 1;
+	mutex_unlock(&opp_mutex);
+	if (started)
+		opp_tune_wait();
+}
+
+#define OPP_TUNE_FIELDS "rate status min_stable_uv failed_uv applied_uv steps error"
+
+static int proc_opptimizer_tune_show(struct seq_file *m, void *v)
+{
+	struct opp_tune_result *r;
+	int i;
+
+	mutex_lock(&opp_mutex);
+	seq_printf(m, "state=%s\n", tune_task ? "running" : "idle");
+	if (tune_task) {
+		seq_printf(m, "opp=%d\n", tune_ctx.index);
+		seq_printf(m, "rate=%lu\n", tune_ctx.rate);
+		seq_printf(m, "u_volt=%lu\n", tune_cur_uv);
+	}
+	seq_printf(m, "profile_fields=%s\n", OPP_TUNE_FIELDS);
+	for (i = 0; i < tune_profile_count; i++) {
+		r = &tune_profile[i].r;
+		seq_printf(m, "profile%d=%lu %s %lu %lu %lu %u %d\n", i,
+			   tune_profile[i].rate, opp_tune_status_name(r->status),
+			   r->min_stable_uv, r->failed_uv, r->applied_uv,
+			   r->steps, r->error);
+	}
+	mutex_unlock(&opp_mutex);
+	return 0;
+}
+
+/*
+ * Commands accepted by /proc/opptimizer_tune:
+ *   <n> [<rate>]	search the lowest stable voltage of OPP n, at <rate>
+ *			if given, otherwise at its current rate
+ *   stop		abort the running search
+ */
+static ssize_t proc_opptimizer_tune_write(struct file *filp, const char __user *buffer,
+					  size_t len, loff_t *off)
+{
+	char cmd[32];
+	unsigned long rate = 0;
+	int index, ret;
+
+	if (!len || len >= sizeof(cmd))
+		return -ENOSPC;
+	if (copy_from_user(cmd, buffer, len))
+		return -EFAULT;
+	cmd[len] = 0;
+
+	if (!strncmp(cmd, "stop", 4)) {
+		opp_tune_stop();
+		return len;
+	}
+	if (sscanf(cmd, "%d %lu", &index, &rate) < 1)
+		return -EINVAL;
+
+	mutex_lock(&opp_mutex);
+	ret = opp_tune_start(index, rate);
+	mutex_unlock(&opp_mutex);
+	return ret ? ret : len;
+}
+
+/* Restore one OPP to its load-time state. Order matters: when speeding up,
+ * raise voltage first. When slowing down, lower frequency first. This
+ * prevents brownouts and excessive power draw. */
+static void opp_restore_entry(struct opp_entry *e, bool active)
+{
+	struct omap_volt_data vdata_current;
+	int ret = 0;
+
+	mutex_lock(&vdd1->scaling_mutex);
+	if (e->opp->enabled != e->default_enabled) {
+		if (e->default_enabled)
+			opp_enable_fp(e->opp);
+		else
+			opp_disable_fp(e->opp);
+	}
+
+	memcpy(&vdata_current, e->vdata, sizeof(vdata_current));
+	if (e->opp->rate < e->default_rate) {
+		/* Current rate is below default, so we're speeding up.
+		 * Raise voltage FIRST, then frequency, to prevent brownouts. */
+		opp_restore_vdata(e->vdata, e->default_vdata);
+		e->vdata->abb = e->default_vdata->abb;
+		if (active)
+			ret = opp_abb_scale_voltage(e, &vdata_current);
+		opp_set_rate(e, e->default_rate);
+	} else {
+		/* Current rate is at or above default, so we're slowing down.
+		 * Lower frequency FIRST, then voltage, to prevent excessive power
+		 * draw. Editing opp->rate alone doesn't move the clock, so push
+		 * the new rate through cpufreq before dropping the voltage. */
+		opp_set_rate(e, e->default_rate);
+		if (active) {
+			opp_sync_policy();
+			mutex_unlock(&vdd1->scaling_mutex);
+			cpufreq_update_policy_fp(0);
+			mutex_lock(&vdd1->scaling_mutex);
+		}
+		opp_restore_vdata(e->vdata, e->default_vdata);
+		e->vdata->abb = e->default_vdata->abb;
+		if (active)
+			ret = opp_abb_scale_voltage(e, &vdata_current);
+	}
+	mutex_unlock(&vdd1->scaling_mutex);
+	if (ret)
+		printk(KERN_ERR "opptimizer: OPP%d restored without its ABB setting (%d)\n",
+		       (int)(e - mpu_opps), ret);
+}
+
+/* Every MPU OPP back to its load-time rate and voltage. Like the boot
+ * profile, OPPs that speed up go first, top down, then the rest bottom
+ * up, so the table stays in order at every step while cpufreq runs in
+ * between. Caller holds opp_mutex. */
+static void opp_restore_opps(void)
+{
+	bool up[OPP_MAX_COUNT];
+	int i, n, active;
+
+	active = opp_find_active();
+	for (i = 0; i < opp_count; i++)
+		up[i] = mpu_opps[i].opp->rate < mpu_opps[i].default_rate;
+	for (n = 0; n < 2 * opp_count; n++) {
+		i = n < opp_count ? n : 2 * opp_count - 1 - n;
+		if (up[i] == (n < opp_count))
+			opp_restore_entry(&mpu_opps[i], i == active);
+	}
+}
+
+/* Everything back to its load-time state. Caller holds opp_mutex. */
+static void opp_restore_all(void)
+{
+	int i;
+
+	opp_restore_opps();
+	for (i = 0; i < opp_count; i++)
+		sr_pinned[i] = false;
+	opp_vdata_restore_all();
+	opp_vp_restore();
+	opp_table_restore(&l3_table);
+	opp_table_restore(&dsp_table);
+	enabled_opp_count = opp_count;
+	opp_sync_policy();
+}
+
+/*
+ * Tentative changes. "tentative <s>" arms a deadline: unless "confirm"
+ * arrives within <s> seconds, every change is undone the way the module
+ * does it on unload. Arming again while a deadline is pending moves it,
+ * so a watchdog can keep pushing it out while the device still responds.
+ * The boot profile is applied tentatively when confirm_s is set.
+ *
+ * A device that hangs hard never gets to the revert. That case is left
+ * to the hardware watchdog and oppldr, which keeps a marker of the
+ * unconfirmed profile and won't apply it again on the next boot.
+ * confirm_state and confirm_deadline are protected by opp_mutex.
+ */
+#define CONFIRM_MAX_S	3600
+
+enum opp_confirm_state {
+	CONFIRM_NONE,		/* nothing tentative since load */
+	CONFIRM_PENDING,	/* waiting for "confirm" */
+	CONFIRM_DONE,		/* confirmed */
+	CONFIRM_REVERTED,	/* deadline passed, back to defaults */
+};
+
+static const char * const confirm_state_names[] = {
+	"none", "pending", "confirmed", "reverted",
+};
+
+static unsigned int confirm_s;
+module_param(confirm_s, uint, 0444);
+MODULE_PARM_DESC(confirm_s, "Revert the boot profile unless confirmed within this many seconds, 0 = off");
+
+static enum opp_confirm_state confirm_state;
+static unsigned long confirm_deadline;	/* jiffies */
+static struct delayed_work confirm_work;
+
+static void opp_confirm_expire(struct work_struct *work)
+{
+	bool expired;
+
+	mutex_lock(&opp_mutex);
+	expired = confirm_state == CONFIRM_PENDING &&
+		  !time_before(jiffies, confirm_deadline);
+	/* Moved out while this work was already queued or running: the
+	 * cancel in opp_confirm_arm() missed it and its schedule did
+	 * nothing, so wait for the new deadline from here. */
+	if (confirm_state == CONFIRM_PENDING && !expired)
+		schedule_delayed_work(&confirm_work, confirm_deadline - jiffies);
+	mutex_unlock(&opp_mutex);
+	if (!expired)
+		return;
+
+	/* The tuner changes voltages too, it has to be out of the way */
+	opp_tune_stop();
+	mutex_lock(&opp_mutex);
+	if (confirm_state == CONFIRM_PENDING) {
+		opp_restore_all();
+		confirm_state = CONFIRM_REVERTED;
+		printk(KERN_WARNING "opptimizer: changes not confirmed in time, back to defaults\n");
+	}
+	mutex_unlock(&opp_mutex);
+	cpufreq_update_policy_fp(0);
+}
+
+/* Caller holds opp_mutex. A work that can't be cancelled any more
+ * re-queues itself for the new deadline. */
+static int opp_confirm_arm(unsigned int s)
+{
+	if (!s || s > CONFIRM_MAX_S)
+		return -EINVAL;
+	confirm_deadline = jiffies + msecs_to_jiffies(s * 1000);
+	confirm_state = CONFIRM_PENDING;
+	cancel_delayed_work(&confirm_work);
+	schedule_delayed_work(&confirm_work, msecs_to_jiffies(s * 1000));
+	printk(KERN_INFO "opptimizer: changes revert in %us unless confirmed\n", s);
+	return 0;
+}
+
+/* Caller holds opp_mutex. A work already past its wait sees the state
+ * and does nothing. */
+static int opp_confirm(void)
+{
+	if (confirm_state != CONFIRM_PENDING)
+		return confirm_state == CONFIRM_REVERTED ? -ETIMEDOUT : 0;
+	confirm_state = CONFIRM_DONE;
+	cancel_delayed_work(&confirm_work);
+	printk(KERN_INFO "opptimizer: changes confirmed\n");
+	return 0;
+}
+
+/*
+ * Thermal guard. A delayed work samples the bandgap sensor every
+ * thermal_interval_ms and feeds opp_thermal.c, which decides how far
+ * the MPU rate has to be capped. The cap is applied through
+ * opp_sync_policy() like the tuner's pin, the OPP table itself is left
+ * alone so that nothing has to be put back when it lifts. State is
+ * protected by opp_mutex; thermal_switch_mutex serialises turning the
+ * guard on and off, which has to wait for the work outside opp_mutex.
+ */
+#define THERMAL_CLK		"ts_fck"
+#define THERMAL_REG		0x0524	/* CONTROL_TEMP_SENSOR */
+#define THERMAL_SOC		(1 << 9)	/* start of conversion */
+#define THERMAL_EOCZ		(1 << 8)	/* high while converting */
+#define THERMAL_ADC_MASK	0x7f
+#define THERMAL_POLL_US		50
+#define THERMAL_POLL_COUNT	40	/* 2ms, a conversion takes well under 1ms */
+#define THERMAL_INTERVAL_DEF	1000	/* ms */
+#define THERMAL_INTERVAL_MIN	100	/* ms */
+
+static struct opp_thermal_params thermal_params = {
+	.trips = {
+		{ .temp_mc = 80000, .cap_khz = 1000000 },	/* stock top OPP */
+		{ .temp_mc = 90000, .cap_khz = 800000 },
+	},
+	.count = 2,
+	.hyst_mc = 5000,
+};
+static struct opp_thermal thermal;
+static struct clk *thermal_clk;
+static struct delayed_work thermal_work;
+static DEFINE_MUTEX(thermal_switch_mutex);
+static bool thermal_on;
+static unsigned int thermal_interval_ms = THERMAL_INTERVAL_DEF;
+static int thermal_offset_mc;
+static unsigned long thermal_stamp;
+static unsigned int thermal_errors;
+
+/* Wait for EOCZ to reach @state. */
+static int opp_thermal_poll(u32 state, u32 *reg)
+{
+	int i;
+
+	for (i = 0; i < THERMAL_POLL_COUNT; i++) {
+		*reg = omap_ctrl_readl_fp(THERMAL_REG);
+		if ((*reg & THERMAL_EOCZ) == state)
+			return 0;
+		udelay(THERMAL_POLL_US);
+	}
+	return -ETIMEDOUT;
+}
+
+/* One single shot conversion. */
+static int opp_thermal_read(int *temp_mc)
+{
+	u32 reg = omap_ctrl_readl_fp(THERMAL_REG);
+	int ret;
+
+	omap_ctrl_writel_fp(reg | THERMAL_SOC, THERMAL_REG);
+	ret = opp_thermal_poll(THERMAL_EOCZ, &reg);
+	if (!ret)
+		ret = opp_thermal_poll(0, &reg);
+	omap_ctrl_writel_fp(reg & ~THERMAL_SOC, THERMAL_REG);
+	if (ret)
+		return ret;
+	*temp_mc = opp_thermal_adc_to_mc(reg & THERMAL_ADC_MASK) + thermal_offset_mc;
+	return 0;
+}
+
+/* Caller holds opp_mutex. Returns true if the policy has to be updated. */
+static bool opp_thermal_apply(void)
+{
+	unsigned int cap = opp_thermal_cap_khz(&thermal);
+
+	if (cap == thermal_cap_khz)
+		return false;
+	printk(KERN_INFO "opptimizer: %dmC, thermal state %d, cap %ukhz\n",
+	       thermal.last_mc, thermal.state, cap);
+	thermal_cap_khz = cap;
+	/* A search pinned above the cap would be testing the wrong rate */
+	if (cap && tune_task && tune_ctx.rate / 1000 > cap)
+		tune_abort = 1;
+	opp_sync_policy();
+	return true;
+}
+
+static void opp_thermal_sample(struct work_struct *work)
+{
+	unsigned long now = jiffies;
+	bool update = false;
+	int temp_mc, ret;
+
+	ret = opp_thermal_read(&temp_mc);
+	mutex_lock(&opp_mutex);
+	if (ret) {
+		thermal_errors++;
+	} else {
+		opp_thermal_step(&thermal, temp_mc, jiffies_to_msecs(now - thermal_stamp));
+		thermal_stamp = now;
+		update = opp_thermal_apply();
+	}
+	if (thermal_on)
+		schedule_delayed_work(&thermal_work, msecs_to_jiffies(thermal_interval_ms));
+	mutex_unlock(&opp_mutex);
+	if (update)
+		cpufreq_update_policy_fp(0);
+}
+
+static int opp_thermal_start(void)
+{
+	int ret = 0;
+
+	if (!thermal_clk)
+		return -ENODEV;
+	mutex_lock(&thermal_switch_mutex);
+	if (thermal_on)
+		goto out;
+	ret = clk_enable(thermal_clk);
+	if (ret)
+		goto out;
+	mutex_lock(&opp_mutex);
+	thermal_on = true;
+	thermal_stamp = jiffies;
+	schedule_delayed_work(&thermal_work, 0);
+	mutex_unlock(&opp_mutex);
+out:
+	mutex_unlock(&thermal_switch_mutex);
+	return ret;
+}
+
+/* Stop sampling and lift the cap. */
+static void opp_thermal_stop(void)
+{
+	bool update;
+
+	mutex_lock(&thermal_switch_mutex);
+	if (!thermal_on)
+		goto out;
+	mutex_lock(&opp_mutex);
+	thermal_on = false;
+	mutex_unlock(&opp_mutex);
+	cancel_delayed_work_sync(&thermal_work);
+	clk_disable(thermal_clk);
+
+	mutex_lock(&opp_mutex);
+	update = thermal_cap_khz != 0;
+	thermal_cap_khz = 0;
+	thermal.state = 0;
+	opp_sync_policy();
+	mutex_unlock(&opp_mutex);
+	if (update)
+		cpufreq_update_policy_fp(0);
+out:
+	mutex_unlock(&thermal_switch_mutex);
+}
+
+static int proc_opptimizer_thermal_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	mutex_lock(&opp_mutex);
+	seq_printf(m, "state=%s\n", !thermal_clk ? "unavailable" :
+		   thermal_on ? "running" : "off");
+	seq_printf(m, "temp_mc=%d\n", thermal.last_mc);
+	seq_printf(m, "level=%d\n", thermal.state);
+	seq_printf(m, "cap_khz=%u\n", thermal_cap_khz);
+	seq_printf(m, "interval_ms=%u\n", thermal_interval_ms);
+	seq_printf(m, "hyst_mc=%d\n", thermal_params.hyst_mc);
+	seq_printf(m, "offset_mc=%d\n", thermal_offset_mc);
+	seq_printf(m, "changes=%u\n", thermal.changes);
+	seq_printf(m, "errors=%u\n", thermal_errors);
+	seq_printf(m, "trip_fields=temp_mc cap_khz\n");
+	for (i = 0; i < thermal_params.count; i++)
+		seq_printf(m, "trip%d=%d %u\n", i, thermal_params.trips[i].temp_mc,
+			   thermal_params.trips[i].cap_khz);
+	for (i = 0; i <= OPP_THERMAL_MAX_TRIPS; i++)
+		seq_printf(m, "level%d_ms=%llu\n", i,
+			   (unsigned long long)thermal.state_ms[i]);
+	mutex_unlock(&opp_mutex);
+	return 0;
+}
+
+/*
+ * Commands accepted by /proc/opptimizer_thermal:
+ *   on | off			start or stop the guard, off lifts the cap
+ *   interval <ms>		sampling period
+ *   hyst <mC>			drop below a trip by this much to leave it
+ *   offset <mC>		added to every reading, sensor calibration
+ *   trip <n> <mC> <khz>	set trip n, n == count adds one
+ *   trip <n> off		remove trip n and every trip above it
+ */
+static ssize_t proc_opptimizer_thermal_write(struct file *filp, const char __user *buffer,
+					     size_t len, loff_t *off)
+{
+	struct opp_thermal_params p;
+	char cmd[48];
+	unsigned int khz, ms;
+	int n, mc, ret = 0;
+	bool update = false;
+
+	if (!len || len >= sizeof(cmd))
+		return -ENOSPC;
+	if (copy_from_user(cmd, buffer, len))
+		return -EFAULT;
+	cmd[len] = 0;
+
+	if (sysfs_streq(cmd, "on")) {
+		ret = opp_thermal_start();
+		return ret ? ret : len;
+	}
+	if (sysfs_streq(cmd, "off")) {
+		opp_thermal_stop();
+		return len;
+	}
+
+	mutex_lock(&opp_mutex);
+	p = thermal_params;
+	if (sscanf(cmd, "interval %u", &ms) == 1) {
+		if (ms < THERMAL_INTERVAL_MIN)
+			ret = -EINVAL;
+		else
+			thermal_interval_ms = ms;
+		goto out_unlock;
+	} else if (sscanf(cmd, "offset %d", &mc) == 1) {
+		thermal_offset_mc = mc;
+		goto out_unlock;
+	} else if (sscanf(cmd, "hyst %d", &mc) == 1) {
+		p.hyst_mc = mc;
+	} else if (sscanf(cmd, "trip %d %d %u", &n, &mc, &khz) == 3) {
+		if (n < 0 || n > p.count || n >= OPP_THERMAL_MAX_TRIPS) {
+			ret = -EINVAL;
+			goto out_unlock;
+		}
+		p.trips[n].temp_mc = mc;
+		p.trips[n].cap_khz = khz;
+		if (n == p.count)
+			p.count++;
+	} else if (sscanf(cmd, "trip %d", &n) == 1 && strstr(cmd, "off")) {
+		if (n < 0 || n >= p.count) {
+			ret = -EINVAL;
+			goto out_unlock;
+		}
+		p.count = n;
+	} else {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	if (!opp_thermal_params_valid(&p)) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+	thermal_params = p;
+	/* Re-evaluate the last reading against the new table right away */
+	if (thermal_on) {
+		opp_thermal_step(&thermal, thermal.last_mc, 0);
+		update = opp_thermal_apply();
+	}
+
+out_unlock:
+	mutex_unlock(&opp_mutex);
+	if (update)
+		cpufreq_update_policy_fp(0);
+	return ret ? ret : len;
+}
+
+static void opp_table_show(struct seq_file *m, struct opp_table *t)
+{
+	struct opp_entry *e;
+	int i;
+
+	for (i = 0; i < t->count; i++) {
+		e = &t->opps[i];
+		seq_printf(m, "%sOPP%d: rate %10lu (%10lu) calib %7lu (%7lu)\n",
+			   t->name, i, e->opp->rate, e->default_rate,
+			   e->vdata->u_volt_calib, e->default_vdata->u_volt_calib);
+	}
+}
+
+static int proc_opptimizer_show(struct seq_file *m, void *v)
+{
+	int i;
+	struct omap_opp *opp;
+	struct omap_volt_data *vdata;
+	struct opp_vp_slew vp;
+
+	if (!freq_table || !policy) {
+		seq_puts(m, "Error: freq_table or policy is NULL\n");
+		return 0;
+	}
+
+	opp = mpu_opps[0].opp;
+	vdata = mpu_opps[0].vdata;
+
+	seq_printf(m, "opp rate: %lu\n", opp->rate);
+	seq_printf(m, "freq table [0]: %u\n", freq_table[0].frequency);
+	seq_printf(m, "policy->max: %u\n", policy->max);
+	seq_printf(m, "cpuinfo.max_freq: %u\n", policy->cpuinfo.max_freq);
+	seq_printf(m, "user_policy.max: %u\n", policy->user_policy.max);
+	seq_printf(m, "omap_voltageprocessor_get_voltage: %lu\n", omap_voltageprocessor_get_voltage_fp(0));
+	seq_printf(m, "vdata->u_volt_nominal: %10ld\n", vdata->u_volt_nominal);
+	seq_printf(m, "vdata->u_volt_dyn_nominal: %10ld\n", vdata->u_volt_dyn_nominal);
+	seq_printf(m, "vdata->u_volt_dyn_margin: %10ld\n", vdata->u_volt_dyn_margin);
+	seq_printf(m, "vdata->u_volt_calib: %10ld\n", vdata->u_volt_calib);
+	seq_printf(m, "vdata->sr_nvalue: 0x%08x\n", vdata->sr_nvalue);
+	seq_printf(m, "vdata->sr_errminlimit: %u\n", vdata->sr_errminlimit);
+	seq_printf(m, "vdata->vp_errorgain: 0x%08x\n", vdata->vp_errorgain);
+	seq_printf(m, "vdata->sr_error: 0x%08x\n", vdata->sr_error);
+	seq_printf(m, "vdata->sr_val: 0x%08x\n", vdata->sr_val);
+	seq_printf(m, "vdata->abb: %2s\n", (vdata->abb) ? "yes" : "no");
+	vdata = mpu_opps[0].default_vdata;
+	seq_printf(m, "Default_vdata->u_volt_nominal: %10ld\n", vdata->u_volt_nominal);
+	seq_printf(m, "Default_vdata->u_volt_dyn_nominal: %10ld\n", vdata->u_volt_dyn_nominal);
+	seq_printf(m, "Default_vdata->u_volt_dyn_margin: %10ld\n", vdata->u_volt_dyn_margin);
+	seq_printf(m, "Default_vdata->u_volt_calib: %10ld\n", vdata->u_volt_calib);
+	seq_printf(m, "Default_vdata->sr_nvalue: 0x%08x\n", vdata->sr_nvalue);
+	seq_printf(m, "Default_vdata->sr_errminlimit: %u\n", vdata->sr_errminlimit);
+	seq_printf(m, "Default_vdata->vp_errorgain: 0x%08x\n", vdata->vp_errorgain);
+	seq_printf(m, "Default_vdata->sr_error: 0x%08x\n", vdata->sr_error);
+	seq_printf(m, "Default_vdata->sr_val: 0x%08x\n", vdata->sr_val);
+	seq_printf(m, "Default_vdata->abb: %2s\n", (vdata->abb) ? "yes" : "no");
+	for (i = 0; i < opp_count; i++) {
+		seq_printf(m, "OPP%d: %-3s rate %10lu (%10lu) calib %7lu (%7lu) cpufreq[%d] l3[%d]\n",
+			   i, mpu_opps[i].opp->enabled ? "on" : "off",
+			   mpu_opps[i].opp->rate, mpu_opps[i].default_rate,
+			   mpu_opps[i].vdata->u_volt_calib, mpu_opps[i].default_vdata->u_volt_calib,
+			   mpu_opps[i].cpufreq_index, l3_link[i]);
+	}
+	opp_table_show(m, &l3_table);
+	opp_table_show(m, &dsp_table);
+	opp_vp_read(&vp);
+	seq_printf(m, "VP: step %u/%u (%u/%u) wait %u/%u (%u/%u) timeout %u (%u) settle %llu ns\n",
+		   vp.stepmin, vp.stepmax, vp_default.stepmin, vp_default.stepmax,
+		   vp.waitmin, vp.waitmax, vp_default.waitmin, vp_default.waitmax,
+		   vp.timeout, vp_default.timeout, (unsigned long long)vp_settle_last_ns);
+	if (abb_supported)
+		seq_printf(m, "ABB: %s, %u switches, %u timed out\n",
+			   opp_abb_fbb() ? "FBB" : "bypass", abb_switches, abb_timeouts);
+	for (i = 0; i < vdata_count; i++) {
+		vdata = &vdd1->volt_data[i];
+		seq_printf(m, "VDATA%d: nominal %7lu calib %7lu (%7lu) dyn_nominal %7lu (%7lu) dyn_margin %6lu (%6lu)%s\n",
+			   i, vdata->u_volt_nominal,
+			   vdata->u_volt_calib, vdata_defaults[i].u_volt_calib,
+			   vdata->u_volt_dyn_nominal, vdata_defaults[i].u_volt_dyn_nominal,
+			   vdata->u_volt_dyn_margin, vdata_defaults[i].u_volt_dyn_margin,
+			   vdd1->curr_volt == vdata ? " *" : "");
+	}
+	seq_printf(m, "v%s by @CreamyG31337\n", DRIVER_VERSION);
+	return 0;
+}
+
+/*
+ * /proc/opptimizer_stat is the same data for monitoring tools: one
+ * "key=value" per line, and one line per OPP whose space separated
+ * fields are listed, in order, by the opp_fields line. Fields are only
+ * ever appended so existing parsers keep working.
+ */
+#define OPP_STAT_FIELDS "enabled rate default_rate u_volt_nominal " \
+	"u_volt_calib u_volt_dyn_nominal u_volt_dyn_margin sr_nvalue " \
+	"sr_errminlimit vp_errorgain sr_error sr_val abb l3_link sr_pinned"
+#define TABLE_STAT_FIELDS "rate default_rate u_volt_nominal u_volt_calib " \
+	"default_u_volt_calib"
+#define VDATA_STAT_FIELDS "current u_volt_nominal u_volt_calib " \
+	"default_u_volt_calib u_volt_dyn_nominal default_u_volt_dyn_nominal " \
+	"u_volt_dyn_margin default_u_volt_dyn_margin"
+
+/* <key>_count, <key>_rate, <key>_fields and one <key>N line per OPP */
+static void opp_table_stat_show(struct seq_file *m, struct opp_table *t,
+				const char *key)
+{
+	struct opp_entry *e;
+	int i;
+
+	seq_printf(m, "%s_count=%d\n", key, t->count);
+	if (!t->count)
+		return;
+	seq_printf(m, "%s_rate=%lu\n", key, clk_get_rate_fp(t->clk));
+	seq_printf(m, "%s_fields=%s\n", key, TABLE_STAT_FIELDS);
+	for (i = 0; i < t->count; i++) {
+		e = &t->opps[i];
+		seq_printf(m, "%s%d=%lu %lu %lu %lu %lu\n", key, i,
+			   e->opp->rate, e->default_rate, e->vdata->u_volt_nominal,
+			   e->vdata->u_volt_calib, e->default_vdata->u_volt_calib);
+	}
+}
+
+#define VP_STAT_FIELDS "stepmin stepmax waitmin waitmax timeout"
+
+/* vp_fields, vp (the registers), vp_default, what a wait may go down
+ * to and the settle times since the last change */
+static void opp_vp_stat_show(struct seq_file *m)
+{
+	struct opp_vp_slew vp;
+
+	opp_vp_read(&vp);
+	seq_printf(m, "vp_fields=%s\n", VP_STAT_FIELDS);
+	seq_printf(m, "vp=%u %u %u %u %u\n", vp.stepmin, vp.stepmax,
+		   vp.waitmin, vp.waitmax, vp.timeout);
+	seq_printf(m, "vp_default=%u %u %u %u %u\n", vp_default.stepmin,
+		   vp_default.stepmax, vp_default.waitmin, vp_default.waitmax,
+		   vp_default.timeout);
+	seq_printf(m, "vp_sys_khz=%lu\n", vp_sys_khz);
+	seq_printf(m, "vp_wait_floor=%lu\n", opp_vp_wait_floor());
+	seq_printf(m, "vp_settle_count=%u\n", vp_settle_count);
+	seq_printf(m, "vp_settle_last_ns=%llu\n", (unsigned long long)vp_settle_last_ns);
+	seq_printf(m, "vp_settle_max_ns=%llu\n", (unsigned long long)vp_settle_max_ns);
+}
+
+static void opp_abb_stat_show(struct seq_file *m)
+{
+	seq_printf(m, "abb_supported=%d\n", abb_supported);
+	seq_printf(m, "abb_fbb=%d\n", opp_abb_fbb());
+	seq_printf(m, "abb_status=%d\n", abb_last_status);
+	seq_printf(m, "abb_switches=%u\n", abb_switches);
+	seq_printf(m, "abb_timeouts=%u\n", abb_timeouts);
+}
+
+static int proc_opptimizer_stat_show(struct seq_file *m, void *v)
+{
+	struct omap_volt_data *vdata;
+	int i;
+
+	if (!freq_table || !policy)
+		return -ENODEV;
+
+	seq_printf(m, "version=%s\n", DRIVER_VERSION);
+	seq_printf(m, "cur_rate=%lu\n", omap_getspeed_fp(0) * 1000UL);
+	seq_printf(m, "vp_volt=%lu\n", omap_voltageprocessor_get_voltage_fp(0));
+	seq_printf(m, "policy_min=%u\n", policy->min);
+	seq_printf(m, "policy_max=%u\n", policy->max);
+	seq_printf(m, "profile_status=%d\n", profile_status);
+	seq_printf(m, "telemetry_period_us=%u\n", opp_telemetry_period_us());
+	seq_printf(m, "confirm_state=%s\n", confirm_state_names[confirm_state]);
+	seq_printf(m, "confirm_left_ms=%u\n", confirm_state == CONFIRM_PENDING &&
+		   time_before(jiffies, confirm_deadline) ?
+		   jiffies_to_msecs(confirm_deadline - jiffies) : 0);
+	seq_printf(m, "opp_count=%d\n", opp_count);
+	seq_printf(m, "opp_fields=%s\n", OPP_STAT_FIELDS);
+	for (i = 0; i < opp_count; i++) {
+		vdata = mpu_opps[i].vdata;
+		seq_printf(m, "opp%d=%d %lu %lu %lu %lu %lu %lu %u %u %u %u %u %d %d %d\n",
+			   i, mpu_opps[i].opp->enabled, mpu_opps[i].opp->rate,
+			   mpu_opps[i].default_rate, vdata->u_volt_nominal,
+			   vdata->u_volt_calib, vdata->u_volt_dyn_nominal,
+			   vdata->u_volt_dyn_margin, vdata->sr_nvalue,
+			   vdata->sr_errminlimit, vdata->vp_errorgain,
+			   vdata->sr_error, vdata->sr_val, vdata->abb, l3_link[i],
+			   sr_pinned[i]);
+	}
+	opp_table_stat_show(m, &l3_table, "l3");
+	if (l3_table.count)
+		seq_printf(m, "vp2_volt=%lu\n", omap_voltageprocessor_get_voltage_fp(VDD2));
+	opp_table_stat_show(m, &dsp_table, "dsp");
+	opp_vp_stat_show(m);
+	opp_abb_stat_show(m);
+	opp_stats_show(m);
+	seq_printf(m, "vdata_count=%d\n", vdata_count);
+	seq_printf(m, "vdata_fields=%s\n", VDATA_STAT_FIELDS);
+	for (i = 0; i < vdata_count; i++) {
+		vdata = &vdd1->volt_data[i];
+		seq_printf(m, "vdata%d=%d %lu %lu %lu %lu %lu %lu %lu\n",
+			   i, vdd1->curr_volt == vdata, vdata->u_volt_nominal,
+			   vdata->u_volt_calib, vdata_defaults[i].u_volt_calib,
+			   vdata->u_volt_dyn_nominal, vdata_defaults[i].u_volt_dyn_nominal,
+			   vdata->u_volt_dyn_margin, vdata_defaults[i].u_volt_dyn_margin);
+	}
+	return 0;
+}
+
+/*
+ * Commands accepted by /proc/opptimizer:
+ *   <rate> [<uV>]		top OPP, same as "opp 0 <rate> [<uV>]"
+ *   opp <n> <rate> [<uV>]	OPP n (0 = highest), uV 0 or missing = default
+ *   enable <n> / disable <n>	turn OPP n on or off
+ *   vdata <i> <field> <uV>	VDD1 voltage table entry i, field is calib,
+ *				dyn_nominal or dyn_margin, uV 0 = default
+ *   sr <n> <nvalue> <errminlimit> <errorgain>
+ *				SmartReflex N target, error min limit (signed,
+ *				-16 to 31) and VP error gain (1 to 63) of OPP n,
+ *				kept through later voltage changes
+ *   sr <n> 0			OPP n back to its default SmartReflex values
+ *   abb <n> <0|1|default>	ABB LDO of OPP n bypassed (0) or forward biasing
+ *				(1), switched now if the MPU runs at OPP n
+ *   telemetry <us>		sample rate and VDD1 every us microseconds into the
+ *				rings mapped by /dev/opptimizer, 0 stops
+ *   tentative <s>		undo all changes unless confirmed within s seconds
+ *   confirm			keep the changes made since "tentative"
+ *   vp <field> <value>		VDD1 voltage processor slew, field is stepmin,
+ *				stepmax (PMIC codes per step), waitmin, waitmax
+ *				(sys_clk cycles per code) or timeout (sys_clk
+ *				cycles), 0 = default
+ *   l3 <n> <rate> [<uV>]	L3 OPP n, rate of the interconnect, uV on VDD2
+ *   link <n> <l3>		MPU OPP n pulls L3 OPP <l3> along, -1 unlinks
+ *   dsp <n> <rate> [<uV>]	IVA2 OPP n, uV is the VDD1 entry it shares
+ */
+static ssize_t proc_opptimizer_write(struct file *filp, const char __user *buffer,
+						 size_t len, loff_t *off)
+{
+	struct opp_ioc_transition tx;
+	unsigned long rate, u_volt_req = 0;
+	char field[16];
+	static struct clk *mpu_clk;
+	int index = 0, l3;
+	int n, nvalue, errminlimit = 0, errorgain = 0;
+	int ret;
+
+	mpu_clk = clk_get_fp(NULL, MPU_CLK);
+	if (IS_ERR(mpu_clk))
+		return PTR_ERR(mpu_clk);
+
+	if(!len || len >= BUF_SIZE)
+		return -ENOSPC;
+
+	/* Every exit below has to go through out_unlock. A missing unlock on an
+	 * error path used to leave the big kernel lock held and hang the phone,
+	 * which users saw as a "crash". */
+	mutex_lock(&opp_mutex);
+	if(copy_from_user(buf, buffer, len)) {
+		ret = -EFAULT;
+		goto out_unlock;
+	}
+	buf[len] = 0;
+
+	/* Secondary crash point: If freq_table or policy is NULL (shouldn't happen
+	 * if init succeeded, but could occur due to module removal race or init failure),
+	 * the table edits below would cause immediate kernel panic. */
+	if (!freq_table || !policy) {
+		printk(KERN_ERR "opptimizer: freq_table or policy is NULL!\n");
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	/* Only requests that change an OPP have to wait for the tuner. A
+	 * pending deadline must stay confirmable or the revert would stop
+	 * the search anyway. */
+	if (sscanf(buf, "telemetry %lu", &rate) == 1) {
+		ret = opp_telemetry_start(rate > UINT_MAX ? UINT_MAX : rate);
+	} else if (sscanf(buf, "tentative %lu", &rate) == 1) {
+		ret = opp_confirm_arm(rate > CONFIRM_MAX_S ? 0 : rate);
+	} else if (!strncmp(buf, "confirm", 7)) {
+		ret = opp_confirm();
+	} else if (tune_task) {
+		ret = -EBUSY;
+	} else if (sscanf(buf, "opp %d %lu %lu", &index, &rate, &u_volt_req) >= 2 ||
+	    sscanf(buf, "%lu %lu", &rate, &u_volt_req) >= 1) {
+		memset(&tx, 0, sizeof(tx));
+		tx.flags = OPP_TX_RATE | OPP_TX_VOLT;
+		tx.index = index;
+		tx.rate = rate;
+		tx.u_volt = u_volt_req;
+		ret = (index < 0) ? -EINVAL : opp_transition(&tx);
+	} else if (sscanf(buf, "enable %d", &index) == 1 ||
+		   sscanf(buf, "disable %d", &index) == 1) {
+		if (index < 0 || index >= opp_count)
+			ret = -EINVAL;
+		else
+			ret = opp_set_enabled(index, buf[0] == 'e');
+	} else if (sscanf(buf, "vdata %d %15s %lu", &index, field, &u_volt_req) == 3) {
+		ret = opp_vdata_set(index, field, u_volt_req);
+	} else if ((n = sscanf(buf, "sr %d %i %i %i", &index, &nvalue, &errminlimit,
+			       &errorgain)) >= 2) {
+		/* The ranges are checked by opp_xition_check_sr(), only what
+		 * doesn't fit the request fields is refused here */
+		if (index < 0 || (n != 2 && n != 4) || (n == 2 && nvalue))
+			ret = -EINVAL;
+		else if (nvalue < 0 || errminlimit < -128 || errminlimit > 255 ||
+			 errorgain < 0 || errorgain > 255)
+			ret = -ERANGE;
+		else {
+			memset(&tx, 0, sizeof(tx));
+			tx.flags = OPP_TX_SR;
+			tx.index = index;
+			tx.sr_nvalue = nvalue;
+			tx.sr_errminlimit = errminlimit;
+			tx.vp_errorgain = errorgain;
+			ret = opp_transition(&tx);
+		}
+	} else if (sscanf(buf, "abb %d %15s", &index, field) == 2) {
+		memset(&tx, 0, sizeof(tx));
+		tx.flags = OPP_TX_ABB;
+		tx.index = index;
+		if (!strcmp(field, "default"))
+			tx.abb = OPP_ABB_DEFAULT;
+		else if (!strcmp(field, "0") || !strcmp(field, "1"))
+			tx.abb = field[0] - '0';
+		else
+			index = -1;
+		ret = (index < 0) ? -EINVAL : opp_transition(&tx);
+	} else if (sscanf(buf, "vp %15s %lu", field, &rate) == 2) {
+		ret = opp_vp_set(field, rate);
+	} else if (sscanf(buf, "l3 %d %lu %lu", &index, &rate, &u_volt_req) >= 2) {
+		ret = opp_table_edit(&l3_table, index, rate, u_volt_req);
+	} else if (sscanf(buf, "link %d %d", &index, &l3) == 2) {
+		ret = opp_l3_link(index, l3);
+	} else if (sscanf(buf, "dsp %d %lu %lu", &index, &rate, &u_volt_req) >= 2) {
+		ret = opp_table_edit(&dsp_table, index, rate, u_volt_req);
+	} else {
+		printk(KERN_INFO "opptimizer: incorrect parameters\n");
+		ret = -EINVAL;
+	}
+
+out_unlock:
+	mutex_unlock(&opp_mutex);
+	return ret ? ret : len;
+};
+
+static int proc_opptimizer_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_opptimizer_show, NULL);
+}
+
+static const struct file_operations proc_opptimizer_fops = {
+	.owner		= THIS_MODULE,
+	.open		= proc_opptimizer_open,
+	.read		= seq_read,
+	.write		= proc_opptimizer_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int proc_opptimizer_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_opptimizer_stat_show, NULL);
+}
+
+static const struct file_operations proc_opptimizer_stat_fops = {
+	.owner		= THIS_MODULE,
+	.open		= proc_opptimizer_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int proc_opptimizer_tune_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_opptimizer_tune_show, NULL);
+}
+
+static const struct file_operations proc_opptimizer_tune_fops = {
+	.owner		= THIS_MODULE,
+	.open		= proc_opptimizer_tune_open,
+	.read		= seq_read,
+	.write		= proc_opptimizer_tune_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int proc_opptimizer_tis_show(struct seq_file *m, void *v)
+{
+	opp_stats_show_time_in_state(m);
+	return 0;
+}
+
+static int proc_opptimizer_tis_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_opptimizer_tis_show, NULL);
+}
+
+static const struct file_operations proc_opptimizer_tis_fops = {
+	.owner		= THIS_MODULE,
+	.open		= proc_opptimizer_tis_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int proc_opptimizer_thermal_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_opptimizer_thermal_show, NULL);
+}
+
+static const struct file_operations proc_opptimizer_thermal_fops = {
+	.owner		= THIS_MODULE,
+	.open		= proc_opptimizer_thermal_open,
+	.read		= seq_read,
+	.write		= proc_opptimizer_thermal_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Asynchronous transitions. OPP_IOC_SUBMIT parks the request in a single
+ * slot and returns; opp_async_work() runs it on the module's own
+ * workqueue with the same locking as a synchronous request. A request
+ * that arrives while one is parked replaces it, so a caller that keeps
+ * submitting only ever waits for the newest one. Results are read from
+ * /dev/opptimizer, see struct opp_ioc_result.
+ *
+ * async_lock covers the slot, the last result and the sequence numbers.
+ * Each open file keeps the last sequence number it has read in
+ * file->private_data.
+ */
+#define ASYNC_SEQ_MASK	0x7fffffff	/* returned from ioctl(), keep it positive */
+
+static struct workqueue_struct *async_wq;
+static struct work_struct async_work;
+static DEFINE_SPINLOCK(async_lock);
+static DECLARE_WAIT_QUEUE_HEAD(async_wait);
+static struct opp_ioc_transition async_tx;
+static u32 async_seq;		/* last request submitted */
+static u32 async_tx_seq;	/* request in the slot, 0 if empty */
+static u32 async_dropped;
+static struct opp_ioc_result async_result;
+
+static void opp_async_work(struct work_struct *work)
+{
+	struct opp_ioc_transition tx;
+	u32 seq;
+	int ret;
+
+	spin_lock_bh(&async_lock);
+	seq = async_tx_seq;
+	tx = async_tx;
+	async_tx_seq = 0;
+	spin_unlock_bh(&async_lock);
+	if (!seq)
+		return;
+
+	mutex_lock(&opp_mutex);
+	ret = tune_task ? -EBUSY : opp_transition(&tx);
+	mutex_unlock(&opp_mutex);
+
+	spin_lock_bh(&async_lock);
+	async_result.version = OPP_IOC_VERSION;
+	async_result.seq = seq;
+	async_result.error = ret;
+	async_result.pending = async_tx_seq != 0;
+	async_result.dropped = async_dropped;
+	async_result.tx = tx;
+	spin_unlock_bh(&async_lock);
+	wake_up_interruptible(&async_wait);
+}
+
+/* Returns the sequence number of the request, or -errno */
+static int opp_async_submit(const struct opp_ioc_transition *tx)
+{
+	u32 seq;
+
+	if (!async_wq)
+		return -ENODEV;
+	spin_lock_bh(&async_lock);
+	if (async_tx_seq)
+		async_dropped++;
+	async_seq = (async_seq + 1) & ASYNC_SEQ_MASK;
+	if (!async_seq)
+		async_seq = 1;
+	seq = async_seq;
+	async_tx = *tx;
+	async_tx_seq = seq;
+	spin_unlock_bh(&async_lock);
+	queue_work(async_wq, &async_work);
+	return seq;
+}
+
+/* True if there is a result @file has not read yet */
+static bool opp_async_ready(struct file *file)
+{
+	bool ready;
+
+	spin_lock_bh(&async_lock);
+	ready = async_result.seq != (u32)(unsigned long)file->private_data;
+	spin_unlock_bh(&async_lock);
+	return ready;
+}
+
+static int opp_async_init(void)
+{
+	INIT_WORK(&async_work, opp_async_work);
+	async_wq = create_singlethread_workqueue("opptimizer");
+	return async_wq ? 0 : -ENOMEM;
+}
+
+/* Runs what is still queued, so the restore on unload comes last */
+static void opp_async_exit(void)
+{
+	if (async_wq)
+		destroy_workqueue(async_wq);
+	async_wq = NULL;
+}
+
+/* One telemetry sample, from the hrtimer. Nothing here sleeps or takes
+ * a lock that is held with interrupts on. */
+static void opp_telemetry_sample(struct opp_tm_sample *s)
+{
+	struct omap_volt_data *vdata = vdd1->curr_volt;
+
+	s->rate = omap_getspeed_fp(0);
+	s->vp_volt = omap_voltageprocessor_get_voltage_fp(VDD1);
+	s->sr_error = vdata ? vdata->sr_error : 0;
+	s->sr_val = vdata ? vdata->sr_val : 0;
+}
+
+static int opp_dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret;
+
+	mutex_lock(&opp_mutex);
+	ret = opp_telemetry_mmap(vma);
+	mutex_unlock(&opp_mutex);
+	return ret;
+}
+
+static void opp_fill_info(struct opp_ioc_info *info)
+{
+	info->opp_count = opp_count;
+	info->cur_rate = omap_getspeed_fp(0) * 1000UL;
+	info->vp_volt = omap_voltageprocessor_get_voltage_fp(0);
+}
+
+static int opp_fill_opp(struct opp_ioc_opp *o)
+{
+	struct opp_entry *e;
+
+	if (o->index >= opp_count)
+		return -EINVAL;
+	e = &mpu_opps[o->index];
+	o->enabled = e->opp->enabled;
+	o->rate = e->opp->rate;
+	o->default_rate = e->default_rate;
+	o->u_volt_nominal = e->vdata->u_volt_nominal;
+	o->u_volt_calib = e->vdata->u_volt_calib;
+	o->default_u_volt_calib = e->default_vdata->u_volt_calib;
+	o->sr_nvalue = e->vdata->sr_nvalue;
+	o->sr_errminlimit = e->vdata->sr_errminlimit;
+	o->vp_errorgain = e->vdata->vp_errorgain;
+	o->abb = e->vdata->abb;
+	return 0;
+}
+
+/* /dev/opptimizer: the same operations as the proc file, as fixed-size
+ * structures with real error codes, and transitions that don't block.
+ * See opp_ioctl.h. */
+static long opp_dev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	union {
+		__u32 version;
+		struct opp_ioc_info info;
+		struct opp_ioc_opp opp;
+		struct opp_ioc_transition tx;
+	} u;
+	int ret;
+
+	switch (cmd) {
+	case OPP_IOC_GET_INFO:
+	case OPP_IOC_GET_OPP:
+	case OPP_IOC_TRANSITION:
+	case OPP_IOC_SUBMIT:
+		break;
+	default:
+		return -ENOTTY;
+	}
+
+	if (copy_from_user(&u, argp, _IOC_SIZE(cmd)))
+		return -EFAULT;
+	if (u.version != OPP_IOC_VERSION)
+		return -EINVAL;
+
+	if (!freq_table || !policy)
+		ret = -ENODEV;
+	else if (cmd == OPP_IOC_GET_INFO) {
+		opp_fill_info(&u.info);
+		ret = 0;
+	} else if (cmd == OPP_IOC_GET_OPP)
+		ret = opp_fill_opp(&u.opp);
+	else if (cmd == OPP_IOC_SUBMIT)
+		/* Nothing to copy back, the sequence number is the return value */
+		return opp_async_submit(&u.tx);
+	else {
+		mutex_lock(&opp_mutex);
+		ret = tune_task ? -EBUSY : opp_transition(&u.tx);
+		mutex_unlock(&opp_mutex);
+	}
+
+	if (!ret && copy_to_user(argp, &u, _IOC_SIZE(cmd)))
+		ret = -EFAULT;
+	return ret;
+}
+
+/* Only results that complete after the open are reported */
+static int opp_dev_open(struct inode *inode, struct file *file)
+{
+	spin_lock_bh(&async_lock);
+	file->private_data = (void *)(unsigned long)async_result.seq;
+	spin_unlock_bh(&async_lock);
+	return 0;
+}
+
+static ssize_t opp_dev_read(struct file *file, char __user *buffer,
+			    size_t len, loff_t *off)
+{
+	struct opp_ioc_result result;
+	int ret;
+
+	if (len < sizeof(result))
+		return -EINVAL;
+	if (!opp_async_ready(file)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(async_wait, opp_async_ready(file));
+		if (ret)
+			return ret;
+	}
+
+	spin_lock_bh(&async_lock);
+	result = async_result;
+	spin_unlock_bh(&async_lock);
+	file->private_data = (void *)(unsigned long)result.seq;
+	if (copy_to_user(buffer, &result, sizeof(result)))
+		return -EFAULT;
+	return sizeof(result);
+}
+
+static unsigned int opp_dev_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &async_wait, wait);
+	return opp_async_ready(file) ? POLLIN | POLLRDNORM : 0;
+}
+
+static const struct file_operations opp_dev_fops = {
+	.owner		= THIS_MODULE,
+	.open		= opp_dev_open,
+	.read		= opp_dev_read,
+	.poll		= opp_dev_poll,
+	.mmap		= opp_dev_mmap,
+	.unlocked_ioctl	= opp_dev_ioctl,
+};
+
+static struct miscdevice opp_miscdev = {
+	.minor		= MISC_DYNAMIC_MINOR,
+	.name		= "opptimizer",
+	.fops		= &opp_dev_fops,
+};
+
+/*
+ * Boot profile. oppldr passes the stored profile as the "profile"
+ * parameter, "<n>:<rate>:<uV>" per OPP separated by commas, a voltage of
+ * 0 meaning the default. It is applied before any interface appears, and
+ * all or nothing: the final table is checked as a whole first, and if a
+ * transition still fails every OPP goes back to its default.
+ */
+/* One request per OPP, only used during init */
+static struct opp_ioc_transition profile_tx[OPP_MAX_COUNT];
+static bool profile_set[OPP_MAX_COUNT];
+
+static int opp_profile_parse(char *str)
+{
+	unsigned long rates[OPP_MAX_COUNT], rate, u_volt, rate_min;
+	char *item;
+	int i, index;
+
+	for (i = 0; i < opp_count; i++)
+		rates[i] = mpu_opps[i].opp->rate;
+	while ((item = strsep(&str, ",")) != NULL) {
+		if (!*item)
+			continue;
+		u_volt = 0;
+		if (sscanf(item, "%d:%lu:%lu", &index, &rate, &u_volt) < 2 ||
+		    index < 0 || index >= opp_count || profile_set[index])
+			return -EINVAL;
+		memset(&profile_tx[index], 0, sizeof(profile_tx[index]));
+		profile_tx[index].flags = OPP_TX_RATE | OPP_TX_VOLT;
+		profile_tx[index].index = index;
+		profile_tx[index].rate = rate;
+		profile_tx[index].u_volt = u_volt;
+		profile_set[index] = true;
+		rates[index] = rate;
+	}
+
+	/* Same limits as opp_check_rate(), on the table as it will end up */
+	for (i = 0; i < opp_count; i++) {
+		rate_min = i ? MPU_RATE_MIN_LOW : MPU_RATE_MIN;
+		if (rates[i] > MPU_RATE_MAX || rates[i] < rate_min)
+			return -ERANGE;
+		if (i && rates[i] >= rates[i - 1])
+			return -EINVAL;
+	}
+	return 0;
+}
+
+/* Caller holds opp_mutex. */
+static int opp_profile_apply(void)
+{
+	char str[PROFILE_LEN];
+	int i, n, count = 0, ret;
+	bool up[OPP_MAX_COUNT];
+
+	strlcpy(str, profile, sizeof(str));
+	ret = opp_profile_parse(str);
+	if (ret)
+		return ret;
+
+	/* Every step has to pass opp_check_rate() against the OPPs not
+	 * moved yet: OPPs that speed up go first, top down, then the rest
+	 * bottom up. The direction is taken before anything moves, an OPP
+	 * raised in the first pass is at its target by the second. */
+	for (i = 0; i < opp_count; i++)
+		up[i] = profile_tx[i].rate > mpu_opps[i].opp->rate;
+	for (n = 0; n < 2 * opp_count; n++) {
+		i = n < opp_count ? n : 2 * opp_count - 1 - n;
+		if (!profile_set[i] || up[i] != (n < opp_count))
+			continue;
+		ret = opp_transition(&profile_tx[i]);
+		if (ret)
+			goto rollback;
+		count++;
+	}
+	printk(KERN_INFO "opptimizer: boot profile applied, %d OPPs\n", count);
+	return 0;
+
+rollback:
+	printk(KERN_ERR "opptimizer: boot profile failed at OPP%d (%d), back to defaults\n",
+	       i, ret);
+	opp_restore_opps();
+	opp_sync_policy();
+	return ret;
+}
+
+static int __init opptimizer_init(void)
+{
+	unsigned long freq = ULONG_MAX;
+	struct omap_opp *opp = ERR_PTR(-ENODEV);
+	struct omap_volt_data *volt_data;
+	struct omap_vdd_info *vdds;
+	struct opp_entry *e;
+	int i, ret;
+
+
+	printk(KERN_INFO " %s %s\n", DRIVER_DESCRIPTION, DRIVER_VERSION);
+	printk(KERN_INFO " Created by %s\n", DRIVER_AUTHOR);
+
+	SYMSEARCH_BIND_TABLE(opptimizer, opp_symbols);
+
+	/* vdd_info is the kernel's pointer to its array of VDDs */
+	vdds = *(struct omap_vdd_info **)SYMSEARCH_GET_ADDRESS(vdd_info);
+	if (!vdds) {
+		printk(KERN_ERR "opptimizer: voltage layer not initialised!\n");
+		return -ENODEV;
+	}
+	vdd1 = vdds + VDD1;
+
+	if (!vdd1->volt_data || vdd1->volt_data_count <= 0) {
+		printk(KERN_ERR "opptimizer: VDD1 has no voltage table!\n");
+		return -ENODEV;
+	}
+	vdata_count = min_t(int, vdd1->volt_data_count, VDATA_MAX_COUNT);
+	if (vdata_count != vdd1->volt_data_count)
+		printk(KERN_INFO "opptimizer: managing %d of %d VDD1 voltages\n",
+		       vdata_count, vdd1->volt_data_count);
+	memcpy(vdata_defaults, vdd1->volt_data, sizeof(vdata_defaults[0]) * vdata_count);
+
+	freq_table = cpufreq_frequency_get_table(0);
+	policy = cpufreq_cpu_get(0);
+
+	if (!freq_table || !policy) {
+		printk(KERN_ERR "opptimizer: Failed to get freq_table or policy!\n");
+		ret = -ENODEV;
+		goto err_policy;
+	}
+
+	/* Walk the MPU OPPs from the top down. opp_find_freq_floor with
+	 * ULONG_MAX freq will return the highest OPP, and every further call
+	 * just below the last rate returns the next one. */
+	while (opp_count < OPP_MAX_COUNT) {
+		opp = opp_find_freq_floor_fp(OPP_MPU, &freq);
+		if (!opp || IS_ERR(opp))
+			break;
+
+		volt_data = omap_get_volt_data_fp(0, opp_get_voltage_fp(opp));
+		if (!volt_data) {
+			printk(KERN_ERR "opptimizer: omap_get_volt_data_fp returned NULL in init!\n");
+			ret = -ENODEV;
+			goto err_policy;
+		}
+		if (volt_data < vdd1->volt_data ||
+		    volt_data >= vdd1->volt_data + vdata_count) {
+			printk(KERN_ERR "opptimizer: OPP voltage outside the VDD1 table!\n");
+			ret = -ENODEV;
+			goto err_policy;
+		}
+
+		e = &mpu_opps[opp_count++];
+		e->opp = opp;
+		e->vdata = volt_data;
+		e->cpufreq_index = opp_find_cpufreq_index(opp->rate);
+		e->default_rate = opp->rate;
+		e->default_enabled = opp->enabled;
+		e->default_vdata = &vdata_defaults[volt_data - vdd1->volt_data];
+
+		freq = opp->rate - 1;
+	}
+
+	if (!opp_count) {
+		printk(KERN_ERR "opptimizer: opp_find_freq_floor_fp failed in init!\n");
+		ret = -ENODEV;
+		goto err_policy;
+	}
+	enabled_opp_count = opp_count;
+	if (opp_get_opp_count_fp(OPP_MPU) != opp_count)
+		printk(KERN_INFO "opptimizer: managing %d of %d MPU OPPs\n",
+		       opp_count, opp_get_opp_count_fp(OPP_MPU));
+	for (i = 0; i < OPP_MAX_COUNT; i++)
+		l3_link[i] = -1;
+	INIT_WORK(&l3_follow_work, opp_l3_follow);
+	opp_table_init(&l3_table, vdds);
+	opp_table_init(&dsp_table, vdds);
+	opp_stats_init(omap_getspeed_fp(0));
+	opp_vp_init();
+	opp_abb_init();
+	opp_thermal_init(&thermal, &thermal_params);
+	INIT_DELAYED_WORK(&thermal_work, opp_thermal_sample);
+	INIT_DELAYED_WORK(&confirm_work, opp_confirm_expire);
+	opp_telemetry_init(opp_telemetry_sample);
+	thermal_clk = clk_get_fp(NULL, THERMAL_CLK);
+	if (IS_ERR(thermal_clk)) {
+		printk(KERN_INFO "opptimizer: no %s, thermal guard off\n", THERMAL_CLK);
+		thermal_clk = NULL;
+	}
+
+	buf = (char *)vmalloc(BUF_SIZE);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto err_policy;
+	}
+
+	/* seq_file grows its buffer as needed, so the dump is no longer
+	 * limited to the single page the old read_proc callback got. */
+	if (!proc_create("opptimizer", 0644, NULL, &proc_opptimizer_fops)) {
+		ret = -ENOMEM;
+		goto err_proc;
+	}
+	if (!proc_create("opptimizer_stat", 0444, NULL, &proc_opptimizer_stat_fops)) {
+		ret = -ENOMEM;
+		goto err_stat;
+	}
+	if (!proc_create("opptimizer_tune", 0644, NULL, &proc_opptimizer_tune_fops)) {
+		ret = -ENOMEM;
+		goto err_tune;
+	}
+	if (!proc_create("opptimizer_thermal", 0644, NULL, &proc_opptimizer_thermal_fops)) {
+		ret = -ENOMEM;
+		goto err_thermal;
+	}
+	if (!proc_create("opptimizer_time_in_state", 0444, NULL, &proc_opptimizer_tis_fops)) {
+		ret = -ENOMEM;
+		goto err_tis;
+	}
+	ret = opp_async_init();
+	if (ret)
+		goto err_async;
+	/* /dev/opptimizer for tools that want binary requests and errors */
+	ret = misc_register(&opp_miscdev);
+	if (ret)
+		goto err_misc;
+	ret = cpufreq_register_notifier(&opp_cpufreq_nb, CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret)
+		goto err_notifier;
+
+	/* Nothing below can fail, so a profile applied here never has to
+	 * be unwound by the error path. */
+	if (profile[0]) {
+		mutex_lock(&opp_mutex);
+		profile_status = opp_profile_apply();
+		mutex_unlock(&opp_mutex);
+	}
+
+	opp_latency_init();
+	opp_probe_init();
+	if (thermal_clk && opp_thermal_start())
+		printk(KERN_ERR "opptimizer: could not start the thermal guard\n");
+	/* Armed last, nothing can fail after this */
+	if (profile[0] && !profile_status && confirm_s) {
+		mutex_lock(&opp_mutex);
+		if (opp_confirm_arm(confirm_s))
+			printk(KERN_ERR "opptimizer: confirm_s out of range, profile kept\n");
+		mutex_unlock(&opp_mutex);
+	}
+
+	return 0;
+
+err_notifier:
+	misc_deregister(&opp_miscdev);
+err_misc:
+	opp_async_exit();
+err_async:
+	remove_proc_entry("opptimizer_time_in_state", NULL);
+err_tis:
+	remove_proc_entry("opptimizer_thermal", NULL);
+err_thermal:
+	remove_proc_entry("opptimizer_tune", NULL);
+err_tune:
+	remove_proc_entry("opptimizer_stat", NULL);
+err_stat:
+	remove_proc_entry("opptimizer", NULL);
+err_proc:
+	vfree(buf);
+err_policy:
+	if (policy)
+		cpufreq_cpu_put(policy);
+	return ret;
+};
+
+static void __exit opptimizer_exit(void)
+{
+	opp_probe_exit();
+	opp_latency_exit();
+	cpufreq_unregister_notifier(&opp_cpufreq_nb, CPUFREQ_TRANSITION_NOTIFIER);
+	cancel_work_sync(&l3_follow_work);
+	misc_deregister(&opp_miscdev);
+	opp_async_exit();
+	opp_telemetry_exit();
+	remove_proc_entry("opptimizer_time_in_state", NULL);
+	remove_proc_entry("opptimizer_thermal", NULL);
+	opp_thermal_stop();
+	remove_proc_entry("opptimizer_tune", NULL);
+	opp_tune_stop();
+	remove_proc_entry("opptimizer_stat", NULL);
+	remove_proc_entry("opptimizer", NULL);
+	cancel_delayed_work_sync(&confirm_work);
+
+	vfree(buf);
+
+	if (!freq_table || !policy) {
+		printk(KERN_ERR "opptimizer: freq_table or policy is NULL in exit!\n");
+		return;
+	}
+
+	/* Restore default frequency and voltage on module unload. */
+	mutex_lock(&opp_mutex);
+	opp_restore_all();
+	mutex_unlock(&opp_mutex);
+	cpufreq_cpu_put(policy);
+	printk(KERN_INFO " opptimizer: Reseting values to default... Goodbye!\n");
+};
+
+module_init(opptimizer_init);
+module_exit(opptimizer_exit);
@@ -1,3 +1,20 @@
+/*
+ * opp_info.h - private OMAP3 OPP and voltage layer structures
+ *
+ * None of these are exported by the kernel. They mirror the layouts in
+ * arch/arm/plat-omap/opp.c and arch/arm/mach-omap2/voltage.c of the
+ * 2.6.32.48-dfl61 kernel and must be kept in sync with it by hand.
+ */
+#ifndef _OPP_INFO_H_
+#define _OPP_INFO_H_
+
+#include <linux/list.h>
+#include <linux/plist.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/notifier.h>
+#include <linux/device.h>
+
 /**
  * struct omap_opp - OMAP OPP description structure
  * @enabled:	true/false - marking this OPP as enabled/disabled
@@ -6,30 +23,14 @@
  * @opp_id:	opp identifier (deprecated)
  *
  * This structure stores the OPP information for a given domain.
+ * This kernel keeps OPPs in flat per-domain arrays looked up by
+ * enum opp_t, not in the later list based device_opp layout.
  */
 struct omap_opp {
-	struct list_head node;
-	
 	bool enabled;
 	unsigned long rate;
 	unsigned long u_volt;
 	u8 opp_id;
-	
-	struct device_opp *dev_opp; /* containing device_opp struct */
-};
-
-struct device_opp {
-	struct list_head node;
-	
-	struct omap_hwmod *oh;
-	struct device *dev;
-	
-	struct list_head opp_list;
-	u32 opp_count;
-	u32 enabled_opp_count;
-	
-	int (*set_rate)(struct device *dev, unsigned long rate);
-	unsigned long (*get_rate) (struct device *dev);
 };
 
 /* Voltage processor register offsets */
@@ -179,4 +180,6 @@ struct omap_vdd_info{
 	u8 prm_irqst_reg;
 	struct omap_volt_pmic_info *pmic;
 	struct device vdd_device;
-};
\ No newline at end of file
+};
+
+#endif
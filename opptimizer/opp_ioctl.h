@@ -0,0 +1,230 @@
+/*
+ * opp_ioctl.h - binary interface of /dev/opptimizer
+ *
+ * Shared between opptimizer.ko and userspace tools, so only plain
+ * fixed-size types are used here.
+ *
+ * Every structure starts with a version field that callers must set to
+ * OPP_IOC_VERSION. The kernel rejects anything else with -EINVAL, so a
+ * tool built against an older layout fails loudly instead of reading
+ * garbage. All rates are in Hz and all voltages in microvolts.
+ */
+#ifndef _OPP_IOCTL_H_
+#define _OPP_IOCTL_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define OPP_IOC_VERSION		1
+#define OPP_IOC_MAGIC		'O'
+
+/**
+ * struct opp_ioc_info - OPP_IOC_GET_INFO reply
+ * @version:	set by the caller
+ * @opp_count:	number of MPU OPPs, valid indices are 0 .. opp_count - 1
+ * @cur_rate:	rate the MPU is running at
+ * @vp_volt:	voltage reported by the VDD1 voltage processor
+ */
+struct opp_ioc_info {
+	__u32 version;
+	__u32 opp_count;
+	__u32 cur_rate;
+	__u32 vp_volt;
+};
+
+/**
+ * struct opp_ioc_opp - OPP_IOC_GET_OPP request and reply
+ * @version:		set by the caller
+ * @index:		OPP to query, set by the caller, 0 is the highest
+ * @enabled:		non-zero if the OPP can be used by cpufreq
+ * @rate:		current rate
+ * @default_rate:	rate at module load
+ * @u_volt_nominal:	nominal voltage of the OPP
+ * @u_volt_calib:	calibrated voltage the rail is set to at this OPP
+ * @default_u_volt_calib: calibrated voltage at module load
+ * @sr_nvalue:		SmartReflex N target
+ * @sr_errminlimit:	SmartReflex error min limit
+ * @vp_errorgain:	voltage processor error gain
+ * @abb:		non-zero if ABB is used at this OPP
+ */
+struct opp_ioc_opp {
+	__u32 version;
+	__u32 index;
+	__u32 enabled;
+	__u32 rate;
+	__u32 default_rate;
+	__u32 u_volt_nominal;
+	__u32 u_volt_calib;
+	__u32 default_u_volt_calib;
+	__u32 sr_nvalue;
+	__u8 sr_errminlimit;
+	__u8 vp_errorgain;
+	__u8 abb;
+	__u8 reserved;
+};
+
+/* struct opp_ioc_transition.flags: which inputs to apply */
+#define OPP_TX_RATE		(1 << 0)	/* set @rate */
+#define OPP_TX_VOLT		(1 << 1)	/* set @u_volt, 0 = default */
+#define OPP_TX_SR		(1 << 2)	/* set the three SmartReflex values */
+#define OPP_TX_ABB		(1 << 3)	/* set @abb */
+
+/* With OPP_TX_SR the values stay pinned to the OPP and win over the
+ * defaults later voltage changes would apply, until a request with all
+ * three set to 0 returns the OPP to its load-time values. Ranges:
+ * @sr_errminlimit -16 to 31 as a signed byte, @vp_errorgain 1 to 63,
+ * @sr_nvalue 1 to 0xFFFFFF. Anything else fails with -ERANGE. */
+#define OPP_TX_ALL		(OPP_TX_RATE | OPP_TX_VOLT | OPP_TX_SR | OPP_TX_ABB)
+
+/* struct opp_ioc_transition.abb: 0 bypasses the ABB LDO, 1 selects
+ * forward body bias, OPP_ABB_DEFAULT returns to the load-time setting.
+ * Fails with -ENODEV where VDD1 has no ABB LDO. */
+#define OPP_ABB_DEFAULT		0xFF
+
+/* struct opp_ioc_transition.abb_status: the ABB LDO during the request */
+#define OPP_ABB_IDLE		0	/* not switched */
+#define OPP_ABB_DONE		1	/* switched, the LDO reported done */
+#define OPP_ABB_TIMEOUT		2	/* switched, no done from the LDO */
+
+/* struct opp_ioc_transition.clamped: why a value differs from the request */
+#define OPP_CLAMP_VOLT_MIN	(1 << 0)	/* raised to the 1.0V floor */
+#define OPP_CLAMP_VOLT_MAX	(1 << 1)	/* lowered to the 1.425V ceiling */
+
+/**
+ * struct opp_ioc_transition - OPP_IOC_TRANSITION request and reply
+ * @version:		set by the caller
+ * @flags:		OPP_TX_* bits selecting the inputs below
+ * @index:		OPP to change, 0 is the highest
+ * @rate:		new rate, must stay between the neighbouring OPPs
+ * @u_volt:		new calibrated voltage, 0 returns to the default
+ * @sr_nvalue:		new SmartReflex N target, 24 bits
+ * @sr_errminlimit:	new SmartReflex error min limit
+ * @vp_errorgain:	new voltage processor error gain
+ * @abb:		new body bias mode, see OPP_ABB_DEFAULT
+ * @abb_status:		reply: OPP_ABB_* state of the ABB LDO
+ * @applied_rate:	reply: rate of the OPP after the transition
+ * @applied_u_volt:	reply: calibrated voltage of the OPP afterwards
+ * @vp_volt:		reply: voltage processor reading afterwards
+ * @clamped:		reply: OPP_CLAMP_* bits
+ * @duration_ns:	reply: time the whole transition took
+ *
+ * The inputs are validated before anything is touched; a rejected
+ * request returns an error and leaves the OPP unchanged. So does an ABB
+ * switch that has to complete before the rail goes down and times out.
+ */
+struct opp_ioc_transition {
+	__u32 version;
+	__u32 flags;
+	__u32 index;
+	__u32 rate;
+	__u32 u_volt;
+	__u32 sr_nvalue;
+	__u8 sr_errminlimit;
+	__u8 vp_errorgain;
+	__u8 abb;
+	__u8 abb_status;
+
+	__u32 applied_rate;
+	__u32 applied_u_volt;
+	__u32 vp_volt;
+	__u32 clamped;
+	__u64 duration_ns;
+};
+
+/**
+ * struct opp_ioc_result - what read() on /dev/opptimizer returns
+ * @version:	OPP_IOC_VERSION
+ * @seq:	the number OPP_IOC_SUBMIT returned for the request
+ * @error:	0, or the negative errno the transition failed with
+ * @pending:	non-zero if a newer request is already queued
+ * @dropped:	requests replaced by a newer one before they ran, since load
+ * @tx:		the request, with the reply fields filled in on success
+ *
+ * OPP_IOC_SUBMIT queues a transition and returns its sequence number
+ * at once. Only the newest queued request is kept. A request that is
+ * replaced before it runs never gets a result of its own; the result of
+ * the request that replaced it, with a higher @seq, stands for it.
+ * Every open file sees each result once. poll() reports POLLIN and
+ * read() returns as soon as a result the file has not seen yet is
+ * there; read() blocks until then unless the file is non-blocking.
+ */
+struct opp_ioc_result {
+	__u32 version;
+	__u32 seq;
+	__s32 error;
+	__u32 pending;
+	__u32 dropped;
+	__u32 reserved;
+	struct opp_ioc_transition tx;
+};
+
+/*
+ * Telemetry. Once sampling has been started (see /proc/opptimizer),
+ * mmap() of /dev/opptimizer, read-only and from offset 0, maps the
+ * sample rings: a struct opp_tm_header at offset 0, then @cpus rings of
+ * @ring_size bytes from @ring_offset on. Each ring is a struct
+ * opp_tm_ring followed by @entries samples, written by the CPU that
+ * took them and never locked. Sample n is at entry n % @entries. A
+ * reader keeps its own position, reads @head, then the samples up to
+ * it. It checks each sample's @seq before and after copying the sample,
+ * with a read barrier in between: if either is not the number it
+ * expects, the sample was overwritten while it was being read.
+ */
+#define OPP_TM_MAGIC		0x4d54504f	/* "OPTM" */
+
+/**
+ * struct opp_tm_header - start of the telemetry mapping
+ * @magic:		OPP_TM_MAGIC
+ * @version:		OPP_IOC_VERSION
+ * @cpus:		number of rings
+ * @entries:		samples per ring, a power of two
+ * @ring_offset:	offset of the first ring in the mapping
+ * @ring_size:		distance between two rings
+ * @period_ns:		sampling period, 0 while stopped
+ */
+struct opp_tm_header {
+	__u32 magic;
+	__u32 version;
+	__u32 cpus;
+	__u32 entries;
+	__u32 ring_offset;
+	__u32 ring_size;
+	__u32 period_ns;
+	__u32 reserved;
+};
+
+/**
+ * struct opp_tm_ring - start of one CPU's ring
+ * @head:	number of samples written so far, the next one goes to
+ *		entry @head % entries. Updated after the sample is written
+ */
+struct opp_tm_ring {
+	__u32 head;
+	__u32 reserved[15];
+};
+
+/**
+ * struct opp_tm_sample - one telemetry sample
+ * @time_ns:	monotonic clock
+ * @seq:	the sample's number in its ring, low 32 bits
+ * @rate:	MPU rate in kHz
+ * @vp_volt:	voltage reported by the VDD1 voltage processor
+ * @sr_error:	SmartReflex error of the VDD1 voltage VDD1 is at
+ * @sr_val:	SmartReflex sensor value of the same voltage
+ */
+struct opp_tm_sample {
+	__u64 time_ns;
+	__u32 seq;
+	__u32 rate;
+	__u32 vp_volt;
+	__u32 sr_error;
+	__u32 sr_val;
+	__u32 reserved;
+};
+
+#define OPP_IOC_GET_INFO	_IOWR(OPP_IOC_MAGIC, 0, struct opp_ioc_info)
+#define OPP_IOC_GET_OPP		_IOWR(OPP_IOC_MAGIC, 1, struct opp_ioc_opp)
+#define OPP_IOC_TRANSITION	_IOWR(OPP_IOC_MAGIC, 2, struct opp_ioc_transition)
+#define OPP_IOC_SUBMIT		_IOW(OPP_IOC_MAGIC, 3, struct opp_ioc_transition)
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * opp_latency.c - DVFS transition latency histograms for opptimizer.ko
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * Every transition made through the module is split into phases (see
+ * enum opp_phase) and each phase is added to a log2 histogram, once
+ * globally and once for the (old rate, new rate) pair of the MPU clock.
+ *
+ * debugfs (usually /sys/kernel/debug/opptimizer/):
+ *   latency		one line per phase over all transitions
+ *   latency_pairs	the same per rate pair, one line per phase that ran
+ *   reset		write anything to clear every histogram
+ *
+ * Line format: <phase> <count> <sum_us> <max_us> <bucket 0> ... <bucket 23>
+ * Bucket 0 counts samples under 1us, bucket n samples from 2^(n-1)us up
+ * to 2^n us. The last bucket also takes everything slower.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+#include <linux/bitops.h>
+
+#include "opp_latency.h"
+
+#define OPP_HIST_BUCKETS	24
+#define OPP_PAIR_COUNT		32	/* rate pairs tracked before dropping */
+
+struct opp_hist {
+	u32 count;
+	u64 sum_ns;
+	u64 max_ns;
+	u32 bucket[OPP_HIST_BUCKETS];
+};
+
+struct opp_pair {
+	unsigned int old_khz;
+	unsigned int new_khz;
+	struct opp_hist phase[OPP_PHASE_COUNT];
+};
+
+static const char *opp_phase_names[OPP_PHASE_COUNT] = {
+	[OPP_PHASE_VSCALE]	= "vscale",
+	[OPP_PHASE_VC_SETUP]	= "vc_setup",
+	[OPP_PHASE_SR_RECAL]	= "sr_recal",
+	[OPP_PHASE_POLICY]	= "policy",
+	[OPP_PHASE_ABB]		= "abb",
+	[OPP_PHASE_TOTAL]	= "total",
+};
+
+static DEFINE_SPINLOCK(opp_latency_lock);
+static struct opp_hist phase_hist[OPP_PHASE_COUNT];
+static struct opp_pair pairs[OPP_PAIR_COUNT];
+static int pair_count;
+static u32 pairs_dropped;
+
+struct dentry *opp_debugfs_dir;
+
+static void opp_hist_add(struct opp_hist *h, u64 ns)
+{
+	int b = fls64(div_u64(ns, 1000));
+
+	if (b >= OPP_HIST_BUCKETS)
+		b = OPP_HIST_BUCKETS - 1;
+	h->bucket[b]++;
+	h->count++;
+	h->sum_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+static struct opp_pair *opp_find_pair(unsigned int old_khz, unsigned int new_khz)
+{
+	int i;
+
+	for (i = 0; i < pair_count; i++) {
+		if (pairs[i].old_khz == old_khz && pairs[i].new_khz == new_khz)
+			return &pairs[i];
+	}
+	if (pair_count == OPP_PAIR_COUNT)
+		return NULL;
+	pairs[pair_count].old_khz = old_khz;
+	pairs[pair_count].new_khz = new_khz;
+	return &pairs[pair_count++];
+}
+
+/**
+ * opp_latency_record - add one transition to the histograms
+ * @old_khz:	MPU rate before the transition
+ * @new_khz:	MPU rate after it
+ * @t:		phase durations, phases missing from t->ran are skipped
+ */
+void opp_latency_record(unsigned int old_khz, unsigned int new_khz,
+			const struct opp_timing *t)
+{
+	struct opp_pair *pair;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&opp_latency_lock, flags);
+	pair = opp_find_pair(old_khz, new_khz);
+	if (!pair)
+		pairs_dropped++;
+	for (i = 0; i < OPP_PHASE_COUNT; i++) {
+		if (!(t->ran & (1 << i)))
+			continue;
+		opp_hist_add(&phase_hist[i], t->ns[i]);
+		if (pair)
+			opp_hist_add(&pair->phase[i], t->ns[i]);
+	}
+	spin_unlock_irqrestore(&opp_latency_lock, flags);
+}
+
+static void opp_hist_show(struct seq_file *m, int phase, const struct opp_hist *h)
+{
+	int i;
+
+	seq_printf(m, "%s %u %llu %llu", opp_phase_names[phase], h->count,
+		   div_u64(h->sum_ns, 1000), div_u64(h->max_ns, 1000));
+	for (i = 0; i < OPP_HIST_BUCKETS; i++)
+		seq_printf(m, " %u", h->bucket[i]);
+	seq_putc(m, '\n');
+}
+
+static int opp_latency_show(struct seq_file *m, void *v)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&opp_latency_lock, flags);
+	for (i = 0; i < OPP_PHASE_COUNT; i++)
+		opp_hist_show(m, i, &phase_hist[i]);
+	spin_unlock_irqrestore(&opp_latency_lock, flags);
+	return 0;
+}
+
+/* Each line is prefixed with "<old_khz> <new_khz>". */
+static int opp_latency_pairs_show(struct seq_file *m, void *v)
+{
+	unsigned long flags;
+	int i, j;
+
+	spin_lock_irqsave(&opp_latency_lock, flags);
+	for (i = 0; i < pair_count; i++) {
+		for (j = 0; j < OPP_PHASE_COUNT; j++) {
+			if (!pairs[i].phase[j].count)
+				continue;
+			seq_printf(m, "%u %u ", pairs[i].old_khz, pairs[i].new_khz);
+			opp_hist_show(m, j, &pairs[i].phase[j]);
+		}
+	}
+	if (pairs_dropped)
+		seq_printf(m, "# %u transitions from untracked rate pairs\n", pairs_dropped);
+	spin_unlock_irqrestore(&opp_latency_lock, flags);
+	return 0;
+}
+
+static int opp_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, opp_latency_show, NULL);
+}
+
+static int opp_latency_pairs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, opp_latency_pairs_show, NULL);
+}
+
+static ssize_t opp_latency_reset_write(struct file *file, const char __user *buffer,
+				       size_t len, loff_t *off)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&opp_latency_lock, flags);
+	memset(phase_hist, 0, sizeof(phase_hist));
+	memset(pairs, 0, sizeof(pairs));
+	pair_count = 0;
+	pairs_dropped = 0;
+	spin_unlock_irqrestore(&opp_latency_lock, flags);
+	return len;
+}
+
+static const struct file_operations opp_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= opp_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations opp_latency_pairs_fops = {
+	.owner		= THIS_MODULE,
+	.open		= opp_latency_pairs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations opp_latency_reset_fops = {
+	.owner		= THIS_MODULE,
+	.write		= opp_latency_reset_write,
+};
+
+/* debugfs is a debugging aid, so failing to create it only costs the
+ * histograms, never the module. */
+int opp_latency_init(void)
+{
+	opp_debugfs_dir = debugfs_create_dir("opptimizer", NULL);
+	if (!opp_debugfs_dir || IS_ERR(opp_debugfs_dir)) {
+		printk(KERN_INFO "opptimizer: debugfs unavailable, no latency histograms\n");
+		opp_debugfs_dir = NULL;
+		return 0;
+	}
+	debugfs_create_file("latency", 0444, opp_debugfs_dir, NULL, &opp_latency_fops);
+	debugfs_create_file("latency_pairs", 0444, opp_debugfs_dir, NULL, &opp_latency_pairs_fops);
+	debugfs_create_file("reset", 0200, opp_debugfs_dir, NULL, &opp_latency_reset_fops);
+	return 0;
+}
+
+void opp_latency_exit(void)
+{
+	debugfs_remove_recursive(opp_debugfs_dir);
+}
@@ -0,0 +1,33 @@
+/*
+ * opp_latency.h - DVFS transition latency histograms
+ *
+ * opp_core.c times each phase of a transition and hands the result to
+ * opp_latency_record(). The histograms are read and reset through
+ * debugfs, see opp_latency.c.
+ */
+#ifndef _OPP_LATENCY_H_
+#define _OPP_LATENCY_H_
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+#include "opp_xition.h"
+
+static inline void opp_timing_end(struct opp_timing *t, enum opp_phase phase,
+				  ktime_t start)
+{
+	if (!t)
+		return;
+	t->ns[phase] = ktime_to_ns(ktime_sub(ktime_get(), start));
+	t->ran |= 1 << phase;
+}
+
+/* debugfs directory of the module, NULL when debugfs is unavailable */
+extern struct dentry *opp_debugfs_dir;
+
+void opp_latency_record(unsigned int old_khz, unsigned int new_khz,
+			const struct opp_timing *t);
+int opp_latency_init(void);
+void opp_latency_exit(void);
+
+#endif
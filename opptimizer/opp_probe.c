@@ -0,0 +1,275 @@
+/*
+ * opp_probe.c - call counting probes on kernel DVFS functions
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * Load with probes=<symbol>,<symbol>,... to hook up to OPP_PROBE_MAX
+ * functions, e.g. probes=omap_voltage_scale,clk_set_rate,sr_class1p5_reset_calib
+ * Every call made by anyone, this module included, goes through a
+ * handler that times the original function and counts it on the CPU it
+ * returned on.
+ *
+ * The handlers pass on r0-r3 and return r0:r1, which covers functions
+ * with up to four word sized arguments. Arguments on the stack are not
+ * passed on, so don't probe anything that takes more.
+ *
+ * On a kernel with CONFIG_PREEMPT the module can't be unloaded again once
+ * a probe is attached, see opp_probe_init().
+ *
+ * debugfs (in the directory of opp_latency.c):
+ *   probes		one line per CPU that made calls and one total per probe
+ *   probes_reset	write anything to clear the counts
+ *
+ * Line format: <symbol> <cpu> <calls> <sum_us> <max_us>
+ * cpu is "all" on the total line.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/kallsyms.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/delay.h>
+#include <asm/atomic.h>
+
+#include "../symsearch/symsearch.h"
+#include "opp_latency.h"
+#include "opp_probe.h"
+
+#define OPP_PROBE_MAX		8
+
+static char probes[OPP_PROBE_MAX * 40];
+module_param_string(probes, probes, sizeof(probes), 0444);
+MODULE_PARM_DESC(probes, "Kernel functions to count and time, <symbol>,...");
+
+struct opp_probe {
+	char name[KSYM_NAME_LEN];
+	struct hook hook;
+};
+
+struct opp_probe_count {
+	u32 calls;
+	u64 sum_ns;
+	u64 max_ns;
+};
+
+struct opp_probe_cpu {
+	struct opp_probe_count probe[OPP_PROBE_MAX];
+};
+
+typedef u64 (*opp_probe_fn)(unsigned long, unsigned long,
+			    unsigned long, unsigned long);
+
+static struct opp_probe opp_probes[OPP_PROBE_MAX];
+static int opp_probe_count;
+static DEFINE_PER_CPU(struct opp_probe_cpu, opp_probe_stats);
+/* handlers running, including callers sleeping inside the original */
+static atomic_t opp_probe_active = ATOMIC_INIT(0);
+
+static u64 opp_probe_call(int n, unsigned long a0, unsigned long a1,
+			  unsigned long a2, unsigned long a3)
+{
+	struct opp_probe_count *c;
+	unsigned long flags;
+	ktime_t start;
+	u64 ret, ns;
+
+	atomic_inc(&opp_probe_active);
+	start = ktime_get();
+	ret = ((opp_probe_fn)opp_probes[n].hook.orig)(a0, a1, a2, a3);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	local_irq_save(flags);
+	c = &__get_cpu_var(opp_probe_stats).probe[n];
+	c->calls++;
+	c->sum_ns += ns;
+	if (ns > c->max_ns)
+		c->max_ns = ns;
+	local_irq_restore(flags);
+
+	atomic_dec(&opp_probe_active);
+	return ret;
+}
+
+/* One entry point per slot, the hook jumps straight here */
+#define OPP_PROBE_HANDLER(n)						\
+static u64 opp_probe_handler_##n(unsigned long a0, unsigned long a1,	\
+				 unsigned long a2, unsigned long a3)	\
+{									\
+	return opp_probe_call(n, a0, a1, a2, a3);			\
+}
+
+OPP_PROBE_HANDLER(0)
+OPP_PROBE_HANDLER(1)
+OPP_PROBE_HANDLER(2)
+OPP_PROBE_HANDLER(3)
+OPP_PROBE_HANDLER(4)
+OPP_PROBE_HANDLER(5)
+OPP_PROBE_HANDLER(6)
+OPP_PROBE_HANDLER(7)
+
+static opp_probe_fn opp_probe_handlers[OPP_PROBE_MAX] = {
+	opp_probe_handler_0, opp_probe_handler_1,
+	opp_probe_handler_2, opp_probe_handler_3,
+	opp_probe_handler_4, opp_probe_handler_5,
+	opp_probe_handler_6, opp_probe_handler_7,
+};
+
+static void opp_probe_line(struct seq_file *m, const char *name, int cpu,
+			   const struct opp_probe_count *c)
+{
+	if (cpu < 0)
+		seq_printf(m, "%s all", name);
+	else
+		seq_printf(m, "%s %d", name, cpu);
+	seq_printf(m, " %u %llu %llu\n", c->calls,
+		   div_u64(c->sum_ns, 1000), div_u64(c->max_ns, 1000));
+}
+
+/* Counts are read without stopping the other CPUs, a line may be one
+ * call behind another. */
+static int opp_probe_show(struct seq_file *m, void *v)
+{
+	struct opp_probe_count total, c;
+	int i, cpu;
+
+	for (i = 0; i < opp_probe_count; i++) {
+		memset(&total, 0, sizeof(total));
+		for_each_possible_cpu(cpu) {
+			c = per_cpu(opp_probe_stats, cpu).probe[i];
+			if (!c.calls)
+				continue;
+			opp_probe_line(m, opp_probes[i].name, cpu, &c);
+			total.calls += c.calls;
+			total.sum_ns += c.sum_ns;
+			if (c.max_ns > total.max_ns)
+				total.max_ns = c.max_ns;
+		}
+		opp_probe_line(m, opp_probes[i].name, -1, &total);
+	}
+	return 0;
+}
+
+static int opp_probe_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, opp_probe_show, NULL);
+}
+
+static ssize_t opp_probe_reset_write(struct file *file, const char __user *buffer,
+				     size_t len, loff_t *off)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(opp_probe_stats, cpu), 0, sizeof(struct opp_probe_cpu));
+	return len;
+}
+
+static const struct file_operations opp_probe_fops = {
+	.owner		= THIS_MODULE,
+	.open		= opp_probe_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations opp_probe_reset_fops = {
+	.owner		= THIS_MODULE,
+	.write		= opp_probe_reset_write,
+};
+
+static int opp_probe_attach(const char *name, int len)
+{
+	struct opp_probe *p = &opp_probes[opp_probe_count];
+	unsigned long address;
+	int ret;
+
+	if (opp_probe_count == OPP_PROBE_MAX || len >= KSYM_NAME_LEN) {
+		printk(KERN_INFO "opptimizer: probe %.*s skipped\n", len, name);
+		return -ENOSPC;
+	}
+	memcpy(p->name, name, len);
+	p->name[len] = '\0';
+
+	address = lookup_symbol_address(p->name);
+	if (!address) {
+		printk(KERN_INFO "opptimizer: probe %s: symbol not found\n", p->name);
+		return -ENOENT;
+	}
+	p->hook.target = address;
+	p->hook.handler = opp_probe_handlers[opp_probe_count];
+	ret = hook_install(&p->hook);
+	if (ret) {
+		printk(KERN_INFO "opptimizer: probe %s: hook failed: %d\n", p->name, ret);
+		return ret;
+	}
+	opp_probe_count++;
+	return 0;
+}
+
+/* Probes are best effort: one that can't be attached is logged and
+ * left out, the rest and the module load normally. */
+int opp_probe_init(void)
+{
+	const char *s = probes, *end;
+
+	while (*s) {
+		end = strchr(s, ',');
+		if (!end)
+			end = s + strlen(s);
+		if (end > s)
+			opp_probe_attach(s, end - s);
+		s = *end ? end + 1 : end;
+	}
+	if (!opp_probe_count)
+		return 0;
+
+#ifdef CONFIG_PREEMPT
+	/* A task preempted between the hook's jump and atomic_inc() in
+	 * opp_probe_call(), or between atomic_dec() and its return, is in
+	 * our text without being counted. A preempted task doesn't hold up
+	 * synchronize_sched() and 2.6.32 has nothing that waits for it, so
+	 * the module stays loaded once a probe is attached. */
+	__module_get(THIS_MODULE);
+	printk(KERN_INFO "opptimizer: probes attached, module pinned until reboot\n");
+#endif
+	if (!opp_debugfs_dir)
+		return 0;
+	debugfs_create_file("probes", 0444, opp_debugfs_dir, NULL, &opp_probe_fops);
+	debugfs_create_file("probes_reset", 0200, opp_debugfs_dir, NULL, &opp_probe_reset_fops);
+	printk(KERN_INFO "opptimizer: %d probes attached\n", opp_probe_count);
+	return 0;
+}
+
+/*
+ * Put the original code back, then wait for every handler still running
+ * before the module text goes away. The originals stay reachable through
+ * the trampolines, which symsearch never frees while we are loaded.
+ * The debugfs files go with the directory in opp_latency_exit().
+ *
+ * Only reached with probes attached when kernel preemption is off, see
+ * opp_probe_init(). A CPU then only schedules once the task on it is out
+ * of the handler or asleep inside the original, which the counter
+ * covers: the first grace period catches callers that had jumped here
+ * but not counted themselves yet, the second those that had uncounted
+ * themselves but not returned.
+ */
+void opp_probe_exit(void)
+{
+	int i;
+
+	for (i = 0; i < opp_probe_count; i++) {
+		if (hook_remove(&opp_probes[i].hook))
+			printk(KERN_ERR "opptimizer: could not detach probe %s\n",
+			       opp_probes[i].name);
+	}
+	synchronize_sched();
+	while (atomic_read(&opp_probe_active))
+		msleep(10);
+	synchronize_sched();
+	opp_probe_count = 0;
+}
@@ -0,0 +1,15 @@
+/*
+ * opp_probe.h - call counting probes on kernel DVFS functions
+ *
+ * The functions named in the "probes" module parameter are hooked through
+ * symsearch for as long as opptimizer.ko is loaded. Each call is counted
+ * and timed per CPU and the totals are read through debugfs, see
+ * opp_probe.c.
+ */
+#ifndef _OPP_PROBE_H_
+#define _OPP_PROBE_H_
+
+int opp_probe_init(void);
+void opp_probe_exit(void);
+
+#endif
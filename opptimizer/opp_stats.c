@@ -0,0 +1,156 @@
+/*
+ * opp_stats.c - MPU time-in-state for opptimizer.ko
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * One entry per rate the MPU has run at, sorted by rate. Time is kept in
+ * jiffies and charged to the current rate whenever the rate changes or
+ * the table is read, the same way cpufreq_stats does it.
+ *
+ * /proc/opptimizer_time_in_state has the cpufreq_stats format, one
+ * "<khz> <time in USER_HZ ticks>" line per rate, so tools written for
+ * cpufreq/stats/time_in_state read it unchanged. /proc/opptimizer_stat
+ * adds the transition counts.
+ */
+#include <linux/kernel.h>
+#include <linux/jiffies.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+
+#include "opp_stats.h"
+
+#define OPP_STATS_COUNT		32	/* rates kept before the least used goes */
+
+struct opp_rate_stat {
+	unsigned int khz;
+	u64 time;		/* jiffies */
+	u32 entered;		/* transitions into this rate */
+};
+
+static DEFINE_SPINLOCK(opp_stats_lock);
+static struct opp_rate_stat rate_stats[OPP_STATS_COUNT];
+static int stats_count;
+static int stats_cur = -1;
+static u64 stats_stamp;
+static u32 total_trans;
+
+/* Charge the time since the last call to the current rate. */
+static void opp_stats_account(void)
+{
+	u64 now = get_jiffies_64();
+
+	if (stats_cur >= 0)
+		rate_stats[stats_cur].time += now - stats_stamp;
+	stats_stamp = now;
+}
+
+/* Index of @khz, added in rate order if it is new. A full table drops
+ * the entry with the least time, never the current one. */
+static int opp_stats_find(unsigned int khz)
+{
+	int i, victim = -1;
+
+	for (i = 0; i < stats_count; i++) {
+		if (rate_stats[i].khz == khz)
+			return i;
+	}
+	if (stats_count == OPP_STATS_COUNT) {
+		for (i = 0; i < stats_count; i++) {
+			if (i != stats_cur && (victim < 0 ||
+			    rate_stats[i].time < rate_stats[victim].time))
+				victim = i;
+		}
+		memmove(&rate_stats[victim], &rate_stats[victim + 1],
+			sizeof(rate_stats[0]) * (stats_count - victim - 1));
+		stats_count--;
+		if (stats_cur > victim)
+			stats_cur--;
+	}
+
+	for (i = 0; i < stats_count && rate_stats[i].khz < khz; i++)
+		;
+	memmove(&rate_stats[i + 1], &rate_stats[i],
+		sizeof(rate_stats[0]) * (stats_count - i));
+	stats_count++;
+	if (stats_cur >= i)
+		stats_cur++;
+	rate_stats[i].khz = khz;
+	rate_stats[i].time = 0;
+	rate_stats[i].entered = 0;
+	return i;
+}
+
+void opp_stats_init(unsigned int khz)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&opp_stats_lock, flags);
+	stats_count = 0;
+	stats_cur = -1;
+	total_trans = 0;
+	stats_stamp = get_jiffies_64();
+	stats_cur = opp_stats_find(khz);
+	spin_unlock_irqrestore(&opp_stats_lock, flags);
+}
+
+/* The MPU now runs at @khz. Calling it again with the same rate only
+ * accounts the time, so callers need not know whether it changed. */
+void opp_stats_update(unsigned int khz)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&opp_stats_lock, flags);
+	opp_stats_account();
+	if (stats_cur < 0 || rate_stats[stats_cur].khz != khz) {
+		i = opp_stats_find(khz);
+		rate_stats[i].entered++;
+		total_trans++;
+		stats_cur = i;
+	}
+	spin_unlock_irqrestore(&opp_stats_lock, flags);
+}
+
+/* Copy out under the lock, seq_printf() may sleep. */
+static int opp_stats_snapshot(struct opp_rate_stat *out, u32 *trans)
+{
+	unsigned long flags;
+	int count;
+
+	spin_lock_irqsave(&opp_stats_lock, flags);
+	opp_stats_account();
+	count = stats_count;
+	memcpy(out, rate_stats, sizeof(rate_stats[0]) * count);
+	*trans = total_trans;
+	spin_unlock_irqrestore(&opp_stats_lock, flags);
+	return count;
+}
+
+void opp_stats_show_time_in_state(struct seq_file *m)
+{
+	struct opp_rate_stat snap[OPP_STATS_COUNT];
+	u32 trans;
+	int i, count;
+
+	count = opp_stats_snapshot(snap, &trans);
+	for (i = 0; i < count; i++)
+		seq_printf(m, "%u %llu\n", snap[i].khz,
+			   (unsigned long long)jiffies_64_to_clock_t(snap[i].time));
+}
+
+void opp_stats_show(struct seq_file *m)
+{
+	struct opp_rate_stat snap[OPP_STATS_COUNT];
+	u32 trans;
+	int i, count;
+
+	count = opp_stats_snapshot(snap, &trans);
+	seq_printf(m, "total_trans=%u\n", trans);
+	seq_printf(m, "tis_count=%d\n", count);
+	seq_printf(m, "tis_fields=khz time_ms entered\n");
+	for (i = 0; i < count; i++)
+		seq_printf(m, "tis%d=%u %llu %u\n", i, snap[i].khz,
+			   div_u64(snap[i].time * 1000, HZ), snap[i].entered);
+}
@@ -0,0 +1,20 @@
+/*
+ * opp_stats.h - MPU time-in-state keyed by the actual rate
+ *
+ * cpufreq_stats builds its table once from freq_table[] and loses track
+ * as soon as an OPP is moved to a rate it has never seen. These stats
+ * are keyed by the rate the MPU really runs at instead, so every rate an
+ * OPP has been edited to gets its own line. opp_core.c reports each
+ * rate change through opp_stats_update().
+ */
+#ifndef _OPP_STATS_H_
+#define _OPP_STATS_H_
+
+#include <linux/seq_file.h>
+
+void opp_stats_init(unsigned int khz);
+void opp_stats_update(unsigned int khz);
+void opp_stats_show_time_in_state(struct seq_file *m);
+void opp_stats_show(struct seq_file *m);
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * opp_telemetry.c - high rate voltage and SmartReflex sampling
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * "telemetry <us>" on /proc/opptimizer starts an hrtimer with that
+ * period, "telemetry 0" stops it. Every tick stores one sample in the
+ * ring of the CPU the timer fired on, so each ring has a single writer
+ * and needs no lock. The rings live in one vmalloc_user() buffer that is
+ * allocated on the first start, kept until unload and mapped read-only
+ * by mmap() of /dev/opptimizer; readers never enter the kernel.
+ *
+ * A slot is reused every OPP_TM_ENTRIES samples. Its seq is written
+ * before the rest and the ring head after it, so a reader that finds
+ * the seq it expects both before and after copying a sample has a
+ * consistent copy.
+ */
+#include <linux/kernel.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/smp.h>
+#include <linux/cpumask.h>
+
+#include "opp_telemetry.h"
+
+#define OPP_TM_ENTRIES		4096	/* per ring, 0.4s at 10kHz */
+#define OPP_TM_PERIOD_MIN_US	100
+#define OPP_TM_PERIOD_MAX_US	1000000
+
+static opp_telemetry_fn opp_tm_fn;
+static struct hrtimer opp_tm_timer;
+static ktime_t opp_tm_period;
+static unsigned int opp_tm_period_us;	/* 0 while stopped */
+static void *opp_tm_buf;		/* NULL until the first start */
+
+static struct opp_tm_ring *opp_tm_ring(int cpu)
+{
+	struct opp_tm_header *h = opp_tm_buf;
+
+	return opp_tm_buf + h->ring_offset + cpu * h->ring_size;
+}
+
+static enum hrtimer_restart opp_tm_tick(struct hrtimer *timer)
+{
+	struct opp_tm_ring *r = opp_tm_ring(smp_processor_id());
+	struct opp_tm_sample *s;
+	u32 head = r->head;
+
+	s = (struct opp_tm_sample *)(r + 1) + (head & (OPP_TM_ENTRIES - 1));
+	s->seq = head;
+	smp_wmb();
+	s->time_ns = ktime_to_ns(ktime_get());
+	opp_tm_fn(s);
+	smp_wmb();
+	r->head = head + 1;
+
+	hrtimer_forward_now(timer, opp_tm_period);
+	return HRTIMER_RESTART;
+}
+
+static int opp_tm_alloc(void)
+{
+	struct opp_tm_header *h;
+	size_t ring_offset, ring_size;
+
+	ring_offset = PAGE_ALIGN(sizeof(*h));
+	ring_size = PAGE_ALIGN(sizeof(struct opp_tm_ring) +
+			       OPP_TM_ENTRIES * sizeof(struct opp_tm_sample));
+	opp_tm_buf = vmalloc_user(ring_offset + nr_cpu_ids * ring_size);
+	if (!opp_tm_buf)
+		return -ENOMEM;
+	h = opp_tm_buf;
+	h->magic = OPP_TM_MAGIC;
+	h->version = OPP_IOC_VERSION;
+	h->cpus = nr_cpu_ids;
+	h->entries = OPP_TM_ENTRIES;
+	h->ring_offset = ring_offset;
+	h->ring_size = ring_size;
+	return 0;
+}
+
+/**
+ * opp_telemetry_start - sample every @period_us microseconds
+ *
+ * Restarts with the new period if sampling is already on, 0 stops it.
+ * Callers serialise start, stop and mmap.
+ */
+int opp_telemetry_start(unsigned int period_us)
+{
+	struct opp_tm_header *h;
+	int ret;
+
+	if (!period_us) {
+		opp_telemetry_stop();
+		return 0;
+	}
+	if (period_us < OPP_TM_PERIOD_MIN_US || period_us > OPP_TM_PERIOD_MAX_US)
+		return -ERANGE;
+	if (!opp_tm_buf) {
+		ret = opp_tm_alloc();
+		if (ret)
+			return ret;
+	}
+
+	hrtimer_cancel(&opp_tm_timer);
+	h = opp_tm_buf;
+	opp_tm_period = ktime_set(0, period_us * NSEC_PER_USEC);
+	opp_tm_period_us = period_us;
+	h->period_ns = period_us * NSEC_PER_USEC;
+	hrtimer_start(&opp_tm_timer, opp_tm_period, HRTIMER_MODE_REL);
+	printk(KERN_INFO "opptimizer: telemetry every %uus\n", period_us);
+	return 0;
+}
+
+void opp_telemetry_stop(void)
+{
+	struct opp_tm_header *h = opp_tm_buf;
+
+	hrtimer_cancel(&opp_tm_timer);
+	opp_tm_period_us = 0;
+	if (h)
+		h->period_ns = 0;
+}
+
+unsigned int opp_telemetry_period_us(void)
+{
+	return opp_tm_period_us;
+}
+
+/* The whole buffer from offset 0, read-only. Samples taken after a
+ * stop and restart keep going to the same pages. */
+int opp_telemetry_mmap(struct vm_area_struct *vma)
+{
+	if (!opp_tm_buf)
+		return -ENODEV;
+	if (vma->vm_pgoff)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, opp_tm_buf, 0);
+}
+
+void opp_telemetry_init(opp_telemetry_fn fn)
+{
+	opp_tm_fn = fn;
+	hrtimer_init(&opp_tm_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	opp_tm_timer.function = opp_tm_tick;
+}
+
+/* Called once /dev/opptimizer is gone, nothing can be mapped any more */
+void opp_telemetry_exit(void)
+{
+	opp_telemetry_stop();
+	vfree(opp_tm_buf);
+	opp_tm_buf = NULL;
+}
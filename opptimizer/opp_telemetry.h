@@ -0,0 +1,26 @@
+/*
+ * opp_telemetry.h - high rate voltage and SmartReflex sampling
+ *
+ * An hrtimer calls back into opp_core.c for one struct opp_tm_sample at
+ * every period and stores it in a ring of the CPU it runs on. The rings
+ * are mapped read-only into userspace through /dev/opptimizer, see
+ * opp_ioctl.h for the layout and opp_telemetry.c for the details.
+ */
+#ifndef _OPP_TELEMETRY_H_
+#define _OPP_TELEMETRY_H_
+
+#include <linux/mm.h>
+
+#include "opp_ioctl.h"
+
+/* Fills everything but @time_ns and @seq, called in hard irq context */
+typedef void (*opp_telemetry_fn)(struct opp_tm_sample *s);
+
+int opp_telemetry_start(unsigned int period_us);
+void opp_telemetry_stop(void);
+unsigned int opp_telemetry_period_us(void);
+int opp_telemetry_mmap(struct vm_area_struct *vma);
+void opp_telemetry_init(opp_telemetry_fn fn);
+void opp_telemetry_exit(void);
+
+#endif
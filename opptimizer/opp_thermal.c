@@ -0,0 +1,102 @@
+/*
+ * opp_thermal.c - thermal guard for opptimizer.ko
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * Plain C only, see opp_thermal.h. The kernel side (sensor access, the
+ * sampling work and procfs) lives in opp_core.c.
+ */
+#include "opp_thermal.h"
+
+void opp_thermal_init(struct opp_thermal *t, const struct opp_thermal_params *p)
+{
+	int i;
+
+	t->p = p;
+	t->state = 0;
+	t->last_mc = 0;
+	for (i = 0; i <= OPP_THERMAL_MAX_TRIPS; i++)
+		t->state_ms[i] = 0;
+	t->changes = 0;
+}
+
+/* Temperatures strictly rising, caps never rising, and the hysteresis
+ * small enough that leaving a trip never drops below the previous one. */
+int opp_thermal_params_valid(const struct opp_thermal_params *p)
+{
+	int i;
+
+	if (p->count < 0 || p->count > OPP_THERMAL_MAX_TRIPS || p->hyst_mc < 0)
+		return 0;
+	for (i = 0; i < p->count; i++) {
+		if (!p->trips[i].cap_khz)
+			return 0;
+		if (i == 0)
+			continue;
+		if (p->trips[i].temp_mc - p->hyst_mc <= p->trips[i - 1].temp_mc ||
+		    p->trips[i].cap_khz > p->trips[i - 1].cap_khz)
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * opp_thermal_step - account one sample and update the state
+ * @t:		controller
+ * @temp_mc:	temperature measured at the end of the interval
+ * @dt_ms:	length of the interval, charged to the state it was spent in
+ *
+ * A single sample may cross several trips at once in either direction.
+ * Returns the new state.
+ */
+int opp_thermal_step(struct opp_thermal *t, int temp_mc, unsigned int dt_ms)
+{
+	const struct opp_thermal_params *p = t->p;
+	int state = t->state;
+
+	t->state_ms[state] += dt_ms;
+	t->last_mc = temp_mc;
+
+	/* The table may have shrunk since the last sample */
+	if (state > p->count)
+		state = p->count;
+	while (state < p->count && temp_mc >= p->trips[state].temp_mc)
+		state++;
+	while (state > 0 && temp_mc < p->trips[state - 1].temp_mc - p->hyst_mc)
+		state--;
+
+	if (state != t->state) {
+		t->state = state;
+		t->changes++;
+	}
+	return state;
+}
+
+/* Rate cap of the current state in kHz, 0 if there is none. */
+unsigned int opp_thermal_cap_khz(const struct opp_thermal *t)
+{
+	if (!t->state)
+		return 0;
+	return t->p->trips[t->state - 1].cap_khz;
+}
+
+/*
+ * OMAP3630 bandgap ADC code to millidegrees C: a straight line through
+ * the end points of the TRM conversion table, every code below 27 reads
+ * as -40C and code 127 as 125C. The sensor is only specified to a few
+ * degrees anyway; a per-device offset is applied by the caller.
+ */
+#define ADC_CODE_MIN	27
+#define ADC_CODE_MAX	127
+#define ADC_MC_MIN	-38000
+#define ADC_MC_MAX	125000
+
+int opp_thermal_adc_to_mc(unsigned int adc)
+{
+	if (adc < ADC_CODE_MIN)
+		return -40000;
+	if (adc > ADC_CODE_MAX)
+		adc = ADC_CODE_MAX;
+	return ADC_MC_MIN + (int)(adc - ADC_CODE_MIN) *
+		((ADC_MC_MAX - ADC_MC_MIN) / (ADC_CODE_MAX - ADC_CODE_MIN));
+}
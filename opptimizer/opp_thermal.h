@@ -0,0 +1,69 @@
+/*
+ * opp_thermal.h - thermal guard for the overclocked OPPs
+ *
+ * Each trip point pairs a die temperature with a cap on the MPU rate.
+ * Crossing a trip moves the guard one state up and applies that trip's
+ * cap. It moves down again once the temperature is hyst_mc below the
+ * trip. The controller only sees temperatures and elapsed time through
+ * opp_thermal_step(), so it runs the same against the bandgap sensor
+ * in opptimizer.ko and against a simulated temperature source on a
+ * host. Keep this file and opp_thermal.c plain C for that reason.
+ */
+#ifndef _OPP_THERMAL_H_
+#define _OPP_THERMAL_H_
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+typedef uint64_t u64;
+#endif
+
+#define OPP_THERMAL_MAX_TRIPS	4
+
+/**
+ * struct opp_thermal_trip - one derating step
+ * @temp_mc:	die temperature in millidegrees C that enters the step
+ * @cap_khz:	highest MPU rate allowed in the step
+ */
+struct opp_thermal_trip {
+	int temp_mc;
+	unsigned int cap_khz;
+};
+
+/**
+ * struct opp_thermal_params - trip table
+ * @trips:	ordered by rising temperature and falling cap
+ * @count:	trips in use
+ * @hyst_mc:	how far below a trip the temperature has to fall to
+ *		leave it again
+ */
+struct opp_thermal_params {
+	struct opp_thermal_trip trips[OPP_THERMAL_MAX_TRIPS];
+	int count;
+	int hyst_mc;
+};
+
+/**
+ * struct opp_thermal - controller state
+ * @p:		trip table, owned by the caller and may change between steps
+ * @state:	0 when no trip is crossed, n when trips[n - 1] is in effect
+ * @last_mc:	last temperature seen
+ * @state_ms:	time spent in each state
+ * @changes:	state changes since opp_thermal_init()
+ */
+struct opp_thermal {
+	const struct opp_thermal_params *p;
+	int state;
+	int last_mc;
+	u64 state_ms[OPP_THERMAL_MAX_TRIPS + 1];
+	unsigned int changes;
+};
+
+void opp_thermal_init(struct opp_thermal *t, const struct opp_thermal_params *p);
+int opp_thermal_params_valid(const struct opp_thermal_params *p);
+int opp_thermal_step(struct opp_thermal *t, int temp_mc, unsigned int dt_ms);
+unsigned int opp_thermal_cap_khz(const struct opp_thermal *t);
+int opp_thermal_adc_to_mc(unsigned int adc);
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * opp_tune.c - undervolt search for opptimizer.ko
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * Plain C only, see opp_tune.h. The kernel side (kthread, procfs and
+ * the real voltage calls) lives in opp_core.c.
+ */
+#include "opp_tune.h"
+
+static const char *opp_tune_status_names[] = {
+	[OPP_TUNE_OK]		= "ok",
+	[OPP_TUNE_FLOOR]	= "floor",
+	[OPP_TUNE_UNSTABLE]	= "unstable",
+	[OPP_TUNE_ABORTED]	= "aborted",
+	[OPP_TUNE_ERROR]	= "error",
+};
+
+const char *opp_tune_status_name(enum opp_tune_status status)
+{
+	if ((unsigned int)status >= sizeof(opp_tune_status_names) / sizeof(opp_tune_status_names[0]))
+		return "?";
+	return opp_tune_status_names[status];
+}
+
+/**
+ * opp_tune_init_params - search limits for an OPP calibrated at @calib_uv
+ *
+ * The search starts from the calibrated voltage, pulled into
+ * [@floor_uv, @ceil_uv], and uses the default step and margin.
+ */
+void opp_tune_init_params(struct opp_tune_params *p, unsigned long calib_uv,
+			  unsigned long floor_uv, unsigned long ceil_uv)
+{
+	if (calib_uv < floor_uv)
+		calib_uv = floor_uv;
+	if (calib_uv > ceil_uv)
+		calib_uv = ceil_uv;
+	p->start_uv = calib_uv;
+	p->floor_uv = floor_uv;
+	p->ceil_uv = ceil_uv;
+	p->step_uv = OPP_TUNE_STEP_UV;
+	p->margin_uv = OPP_TUNE_MARGIN_UV;
+}
+
+/**
+ * opp_tune_run - find the lowest stable voltage and back off from it
+ * @ops:	hardware access, see struct opp_tune_ops
+ * @priv:	passed to every op
+ * @p:		search limits
+ * @r:		filled with the outcome
+ *
+ * The starting voltage is verified first. From there the voltage goes
+ * down one step at a time until a pass fails, the floor is reached or
+ * the caller asks to stop. The OPP is then left at the lowest passing
+ * voltage plus the margin, capped at the ceiling. If even the starting
+ * voltage fails nothing is lowered and the OPP stays at the start.
+ */
+void opp_tune_run(const struct opp_tune_ops *ops, void *priv,
+		  const struct opp_tune_params *p, struct opp_tune_result *r)
+{
+	unsigned long good, u_volt;
+	int ret;
+
+	r->status = OPP_TUNE_OK;
+	r->min_stable_uv = 0;
+	r->failed_uv = 0;
+	r->applied_uv = 0;
+	r->steps = 0;
+	r->error = 0;
+
+	ret = ops->set_voltage(priv, p->start_uv);
+	if (ret) {
+		r->status = OPP_TUNE_ERROR;
+		r->error = ret;
+		return;
+	}
+	r->applied_uv = p->start_uv;
+	r->steps++;
+	ret = ops->verify(priv);
+	if (ret) {
+		r->status = OPP_TUNE_UNSTABLE;
+		r->failed_uv = p->start_uv;
+		r->error = ret;
+		return;
+	}
+
+	good = p->start_uv;
+	for (;;) {
+		if (ops->should_stop(priv)) {
+			r->status = OPP_TUNE_ABORTED;
+			break;
+		}
+		if (good < p->floor_uv + p->step_uv) {
+			r->status = OPP_TUNE_FLOOR;
+			break;
+		}
+		u_volt = good - p->step_uv;
+		ret = ops->set_voltage(priv, u_volt);
+		if (ret) {
+			r->status = OPP_TUNE_ERROR;
+			r->error = ret;
+			break;
+		}
+		r->applied_uv = u_volt;
+		r->steps++;
+		ret = ops->verify(priv);
+		if (ret) {
+			r->failed_uv = u_volt;
+			r->error = ret;
+			break;
+		}
+		good = u_volt;
+	}
+	r->min_stable_uv = good;
+
+	/* Back off. Whatever stopped the search, the OPP must not be left
+	 * at a voltage that just failed or was never verified. */
+	u_volt = good + p->margin_uv;
+	if (u_volt > p->ceil_uv)
+		u_volt = p->ceil_uv;
+	ret = ops->set_voltage(priv, u_volt);
+	if (ret) {
+		r->status = OPP_TUNE_ERROR;
+		r->error = ret;
+		return;
+	}
+	r->applied_uv = u_volt;
+}
+
+/* Integer multiply, shift and rotate chain, the ALU paths that lose
+ * timing first when the voltage gets too low. */
+u32 opp_tune_cpu_pass(u32 seed, unsigned int rounds)
+{
+	u32 x = seed | 1, acc = seed;
+	unsigned int i;
+
+	for (i = 0; i < rounds; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		acc = ((acc << 7) | (acc >> 25)) + x * 0x9E3779B1u;
+		acc ^= (acc >> 11) * (x | 1);
+	}
+	return acc ^ x;
+}
+
+/* Fill @mem with a seeded pattern, fold one half into the other and
+ * checksum the lot, so both the store and the load path are exercised
+ * and a flipped bit anywhere changes the result. */
+u32 opp_tune_mem_pass(u32 *mem, size_t words, u32 seed)
+{
+	size_t i, half = words / 2;
+	u32 x = seed, sum = 0;
+
+	for (i = 0; i < words; i++) {
+		x = x * 1664525u + 1013904223u;
+		mem[i] = x ^ (u32)i;
+	}
+	for (i = 0; i < half; i++)
+		mem[half + i] ^= mem[i] + (u32)i;
+	for (i = 0; i < words; i++)
+		sum = ((sum << 5) | (sum >> 27)) ^ mem[i];
+	return sum;
+}
+
+/* Take the reference checksums. Only call this at a voltage known to be
+ * good, every later pass is compared with what it finds. */
+void opp_tune_ref_init(struct opp_tune_ref *ref, u32 *mem, size_t words,
+		       u32 seed, unsigned int rounds)
+{
+	ref->mem = mem;
+	ref->words = words;
+	ref->seed = seed;
+	ref->rounds = rounds;
+	ref->cpu_sum = opp_tune_cpu_pass(seed, rounds);
+	ref->mem_sum = opp_tune_mem_pass(mem, words, seed);
+}
+
+/* One run of both workloads, -EIO if either checksum is off */
+int opp_tune_ref_check(const struct opp_tune_ref *ref)
+{
+	if (opp_tune_cpu_pass(ref->seed, ref->rounds) != ref->cpu_sum ||
+	    opp_tune_mem_pass(ref->mem, ref->words, ref->seed) != ref->mem_sum)
+		return -EIO;
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * opp_tune.h - undervolt search for one MPU rate
+ *
+ * opp_tune_run() walks the calibrated voltage of one OPP down in VP
+ * sized steps and runs a verification pass at every step. It never
+ * touches the hardware itself; everything goes through struct
+ * opp_tune_ops, so the same code runs inside opptimizer.ko and on a
+ * host against a stand-in for the OMAP voltage functions. Keep this
+ * file and opp_tune.c free of anything but plain C for that reason.
+ */
+#ifndef _OPP_TUNE_H_
+#define _OPP_TUNE_H_
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/errno.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+typedef uint32_t u32;
+#endif
+
+#define OPP_TUNE_STEP_UV	12500	/* one VP step on the TWL PMIC */
+#define OPP_TUNE_MARGIN_UV	25000	/* added back on top of the last pass */
+
+enum opp_tune_status {
+	OPP_TUNE_OK,		/* found a failing step, backed off from it */
+	OPP_TUNE_FLOOR,		/* reached the floor without a failure */
+	OPP_TUNE_UNSTABLE,	/* failed at the starting voltage already */
+	OPP_TUNE_ABORTED,	/* should_stop() said so */
+	OPP_TUNE_ERROR,		/* set_voltage() failed */
+};
+
+/**
+ * struct opp_tune_ops - what opp_tune_run() needs from its caller
+ * @set_voltage:	move the OPP under test to @u_volt, 0 or -errno
+ * @verify:		run one verification pass at the current voltage.
+ *			0 if it passed, -EIO on a miscompare, -ETIMEDOUT if
+ *			it took too long
+ * @should_stop:	non-zero to abandon the search between steps
+ */
+struct opp_tune_ops {
+	int (*set_voltage)(void *priv, unsigned long u_volt);
+	int (*verify)(void *priv);
+	int (*should_stop)(void *priv);
+};
+
+/**
+ * struct opp_tune_params - search limits
+ * @start_uv:	voltage the search starts from, known to be stable
+ * @floor_uv:	lowest voltage that may be tried
+ * @ceil_uv:	the backed off result is never set above this
+ * @step_uv:	distance between two tries
+ * @margin_uv:	added on top of the lowest passing voltage at the end
+ */
+struct opp_tune_params {
+	unsigned long start_uv;
+	unsigned long floor_uv;
+	unsigned long ceil_uv;
+	unsigned long step_uv;
+	unsigned long margin_uv;
+};
+
+/**
+ * struct opp_tune_result - outcome of one search
+ * @status:		enum opp_tune_status
+ * @min_stable_uv:	lowest voltage that passed, 0 if none did
+ * @failed_uv:		voltage that failed, 0 if none did
+ * @applied_uv:		voltage the OPP was left at
+ * @steps:		verification passes run
+ * @error:		last error from the ops, 0 if there was none
+ */
+struct opp_tune_result {
+	enum opp_tune_status status;
+	unsigned long min_stable_uv;
+	unsigned long failed_uv;
+	unsigned long applied_uv;
+	unsigned int steps;
+	int error;
+};
+
+void opp_tune_init_params(struct opp_tune_params *p, unsigned long calib_uv,
+			  unsigned long floor_uv, unsigned long ceil_uv);
+void opp_tune_run(const struct opp_tune_ops *ops, void *priv,
+		  const struct opp_tune_params *p, struct opp_tune_result *r);
+const char *opp_tune_status_name(enum opp_tune_status status);
+
+/* Verification workloads. Both are deterministic: the same arguments
+ * give the same checksum, so a result that differs from one taken at a
+ * known good voltage is a miscompare. */
+u32 opp_tune_cpu_pass(u32 seed, unsigned int rounds);
+u32 opp_tune_mem_pass(u32 *mem, size_t words, u32 seed);
+
+/**
+ * struct opp_tune_ref - what a verification pass is compared against
+ * @mem:	scratch buffer for opp_tune_mem_pass()
+ * @words:	size of @mem in words
+ * @seed:	workload seed
+ * @rounds:	opp_tune_cpu_pass() rounds
+ * @cpu_sum:	opp_tune_cpu_pass() checksum at a known good voltage
+ * @mem_sum:	opp_tune_mem_pass() checksum at a known good voltage
+ */
+struct opp_tune_ref {
+	u32 *mem;
+	size_t words;
+	u32 seed;
+	unsigned int rounds;
+	u32 cpu_sum;
+	u32 mem_sum;
+};
+
+void opp_tune_ref_init(struct opp_tune_ref *ref, u32 *mem, size_t words,
+		       u32 seed, unsigned int rounds);
+int opp_tune_ref_check(const struct opp_tune_ref *ref);
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ * opp_xition.c - MPU OPP transition sequencing for opptimizer.ko
+ * License: GNU GPLv3
+ * <http://www.gnu.org/licenses/gpl-3.0.html>
+ *
+ * Plain C only, see opp_xition.h. The kernel side of every op lives in
+ * opp_core.c, a simulated one in oppsim.c.
+ */
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/string.h>
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+
+#include "opp_xition.h"
+
+#define OPP_XITION_MSG_LEN	64
+
+static void opp_xition_notice(const struct opp_xition_ops *ops, void *priv,
+			      const char *msg)
+{
+	if (ops->notice)
+		ops->notice(priv, msg);
+}
+
+static u64 opp_xition_start(const struct opp_xition_ops *ops, void *priv)
+{
+	return ops->now_ns(priv);
+}
+
+static void opp_xition_end(const struct opp_xition_ops *ops, void *priv,
+			   struct opp_timing *t, enum opp_phase phase, u64 start)
+{
+	t->ns[phase] += ops->now_ns(priv) - start;
+	t->ran |= 1 << phase;
+}
+
+/**
+ * opp_xition_check_rate - may OPP @index run at @rate?
+ *
+ * Returns -ERANGE outside the absolute limits and -EINVAL if the OPP
+ * would pass one of its neighbours, whose order cpufreq relies on.
+ */
+int opp_xition_check_rate(const struct opp_xition_ops *ops, void *priv,
+			  const struct opp_xition_limits *lim,
+			  int index, unsigned long rate)
+{
+	unsigned long rate_min = index ? lim->rate_min_low : lim->rate_min;
+	char msg[OPP_XITION_MSG_LEN];
+
+	if (rate > lim->rate_max || rate < rate_min) {
+		opp_xition_notice(ops, priv, "rate too high or low!");
+		return -ERANGE;
+	}
+	if ((index > 0 && rate >= ops->get_rate(priv, index - 1)) ||
+	    (index < lim->count - 1 && rate <= ops->get_rate(priv, index + 1))) {
+		snprintf(msg, sizeof(msg), "OPP%d must stay between its neighbours!", index);
+		opp_xition_notice(ops, priv, msg);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* True for an OPP_TX_SR request that returns the OPP to its load-time
+ * SmartReflex values instead of setting new ones */
+static int opp_xition_sr_reset(const struct opp_ioc_transition *tx)
+{
+	return !tx->sr_nvalue && !tx->sr_errminlimit && !tx->vp_errorgain;
+}
+
+/**
+ * opp_xition_check_sr - are the SmartReflex values of @tx safe?
+ *
+ * Returns -ERANGE for values outside the OPP_XITION_*_MIN/MAX ranges.
+ * All three 0 is accepted, it asks for the defaults.
+ */
+int opp_xition_check_sr(const struct opp_ioc_transition *tx)
+{
+	int errminlimit = (signed char)tx->sr_errminlimit;
+
+	if (opp_xition_sr_reset(tx))
+		return 0;
+	if (errminlimit < OPP_XITION_ERRMINLIMIT_MIN ||
+	    errminlimit > OPP_XITION_ERRMINLIMIT_MAX ||
+	    tx->vp_errorgain < OPP_XITION_ERRORGAIN_MIN ||
+	    tx->vp_errorgain > OPP_XITION_ERRORGAIN_MAX ||
+	    !tx->sr_nvalue || tx->sr_nvalue > OPP_XITION_NVALUE_MAX)
+		return -ERANGE;
+	return 0;
+}
+
+/* Switch the ABB LDO and record the outcome in @tx */
+static int opp_xition_abb(const struct opp_xition_ops *ops, void *priv,
+			  struct opp_timing *t, struct opp_ioc_transition *tx,
+			  int fbb)
+{
+	u64 start = opp_xition_start(ops, priv);
+	int ret;
+
+	ret = ops->abb_switch(priv, fbb);
+	if (ret > 0)
+		return 0;
+	opp_xition_end(ops, priv, t, OPP_PHASE_ABB, start);
+	tx->abb_status = ret ? OPP_ABB_TIMEOUT : OPP_ABB_DONE;
+	if (ret)
+		opp_xition_notice(ops, priv, fbb ? "ABB LDO did not enter FBB" :
+				  "ABB LDO did not leave FBB");
+	return ret;
+}
+
+/**
+ * opp_xition_run - change the rate, voltage and SmartReflex setup of one MPU OPP
+ * @ops:	kernel access, see struct opp_xition_ops
+ * @priv:	passed to every op
+ * @lim:	request limits
+ * @tx:		the request, see struct opp_ioc_transition. On success the
+ *		reply fields are filled in.
+ * @t:		filled with the duration of each phase
+ *
+ * Every input is checked before the first table is touched, so a failed
+ * request leaves the OPP as it was. The voltage rail is only moved when
+ * the MPU is running at this OPP; for the others only the tables are
+ * edited and the kernel's own DVFS picks the new values up the next time
+ * it switches to them. The result is pushed through cpufreq before
+ * returning; a lower rate for the running OPP is pushed through before
+ * the rail moves as well.
+ *
+ * The ABB LDO switches on the high side of the voltage move: before the
+ * rail goes down, or when it does not move, and after it went up. That
+ * way forward body bias is never on below the voltage it was set up
+ * with, and the rail is never below what the OPP needs without it.
+ */
+int opp_xition_run(const struct opp_xition_ops *ops, void *priv,
+		   const struct opp_xition_limits *lim,
+		   struct opp_ioc_transition *tx, struct opp_timing *t)
+{
+	struct opp_xition_vdata vdata, def;
+	unsigned long rate, old_rate, u_volt_req, vp;
+	char msg[OPP_XITION_MSG_LEN];
+	u64 start, phase_start;
+	int index, active, abb_late, ret;
+
+	if (tx->index >= (u32)lim->count || (tx->flags & ~OPP_TX_ALL))
+		return -EINVAL;
+	index = tx->index;
+	old_rate = ops->get_rate(priv, index);
+
+	rate = old_rate;
+	if (tx->flags & OPP_TX_RATE) {
+		rate = tx->rate;
+		ret = opp_xition_check_rate(ops, priv, lim, index, rate);
+		if (ret)
+			return ret;
+	}
+	if (tx->flags & OPP_TX_SR) {
+		ret = opp_xition_check_sr(tx);
+		if (ret)
+			return ret;
+	}
+	if (tx->flags & OPP_TX_ABB) {
+		if (!ops->abb_switch)
+			return -ENODEV;
+		if (tx->abb > 1 && tx->abb != OPP_ABB_DEFAULT)
+			return -EINVAL;
+	}
+
+	tx->clamped = 0;
+	tx->abb_status = OPP_ABB_IDLE;
+	u_volt_req = tx->u_volt;
+	if (u_volt_req != 0) {
+		if (u_volt_req >= lim->volt_max) {
+			if (u_volt_req > lim->volt_max)
+				tx->clamped |= OPP_CLAMP_VOLT_MAX;
+			u_volt_req = lim->volt_max;
+		}
+		if (u_volt_req <= lim->volt_min) {
+			if (u_volt_req < lim->volt_min)
+				tx->clamped |= OPP_CLAMP_VOLT_MIN;
+			u_volt_req = lim->volt_min;
+		}
+	}
+
+	/* NOTE: opp_disable() is not called here. Disabling the OPP before
+	 * modification might be safer, but testing showed it works without.
+	 * Leaving disabled to avoid potential side effects. */
+	memset(t, 0, sizeof(*t));
+	start = opp_xition_start(ops, priv);
+	ops->lock(priv);
+	active = (ops->active_index(priv) == index);
+	ops->save_vdata(priv, index, &vdata);
+
+	/* When lowering frequency: set rate first, then lower voltage.
+	 * The clock itself only moves in update_policy(), the rate is
+	 * pushed through cpufreq further down once the body bias is set. */
+	if (rate < old_rate)
+		ops->set_rate(priv, index, rate);
+
+	/* Voltage scaling order is critical for stability:
+	 * - When increasing frequency: raise voltage FIRST, then frequency
+	 * - When decreasing frequency: lower frequency FIRST, then voltage
+	 * This prevents brownouts (voltage too low) or excessive power draw.
+	 * The kernel's DVFS is kept out by ops->lock() above. */
+	if (!(tx->flags & OPP_TX_VOLT)) {
+		/* Voltage left alone */
+	} else if (u_volt_req != 0) {
+		/* Update voltage data structure with new calibration values.
+		 * These values are used by the voltage scaling and SmartReflex systems. */
+		vdata.u_volt_calib = u_volt_req;
+		vdata.u_volt_dyn_nominal = u_volt_req;
+		/* Remove dynamic voltage margin for overclocking. Normally the kernel
+		 * adds margin to account for process variation, but when overclocking
+		 * we want precise voltage control without extra headroom. */
+		vdata.u_volt_dyn_margin = 0;
+		/* SmartReflex error minimum limit: 0x16 (22 decimal).
+		 * Default kernel value: 0xF9 (249 decimal).
+		 *
+		 * This is the minimum voltage error threshold before SmartReflex
+		 * Class 1.5 takes corrective action. Lower value = tighter regulation:
+		 * - 0xF9 (249): Loose regulation, only reacts to large voltage errors
+		 * - 0x16 (22):  Tight regulation, reacts to small voltage errors
+		 *
+		 * For overclocking, tighter regulation is critical because:
+		 * 1. Higher frequencies are more sensitive to voltage variations
+		 * 2. Prevents voltage droop that could cause crashes
+		 * 3. Maintains stability at the edge of hardware limits
+		 *
+		 * Trade-off: Tighter regulation uses more power due to more frequent
+		 * voltage adjustments, but this is acceptable for overclocking. */
+		vdata.sr_errminlimit = OPP_XITION_SR_ERRMINLIMIT;
+		/* Voltage Processor error gain: NOT modified (left at default 0x16).
+		 *
+		 * VP error gain controls how aggressively the voltage processor
+		 * corrects voltage errors. Higher value = larger corrections per error:
+		 * - Default 0x16: Moderate correction rate (balanced)
+		 * - 0xFF (255): Maximum correction rate (very aggressive)
+		 *
+		 * We leave this at default because:
+		 * 1. SmartReflex (above) already provides tight regulation
+		 * 2. Over-aggressive VP corrections could cause voltage overshoot/undershoot
+		 * 3. Combined with tight SmartReflex, aggressive VP could create
+		 *    oscillations or instability
+		 *
+		 * The commented line below would enable maximum VP aggressiveness,
+		 * but testing showed it's not needed and can cause instability. */
+		/* vdata.vp_errorgain = 0xFF;  Maximum VP correction rate - DISABLED */
+	} else {
+		/* User didn't specify voltage (u_volt_req == 0), so restore
+		 * SmartReflex settings and return to default voltage. */
+		ops->get_default_vdata(priv, index, &def);
+		vdata.u_volt_calib = def.u_volt_calib;
+		vdata.u_volt_dyn_nominal = def.u_volt_dyn_nominal;
+		vdata.u_volt_dyn_margin = def.u_volt_dyn_margin;
+		vdata.sr_errminlimit = def.sr_errminlimit;
+		vdata.vp_errorgain = def.vp_errorgain;
+		vdata.sr_nvalue = def.sr_nvalue;
+		if (active && def.u_volt_calib != ops->vp_voltage(priv))
+			opp_xition_notice(ops, priv, "returning to default voltage");
+	}
+	/* Explicit SmartReflex values win over the overclocking defaults
+	 * above, and so do values pinned to this OPP by an earlier request.
+	 * Asking for the defaults unpins them. */
+	if ((tx->flags & OPP_TX_SR) && opp_xition_sr_reset(tx)) {
+		ops->get_default_vdata(priv, index, &def);
+		vdata.sr_errminlimit = def.sr_errminlimit;
+		vdata.vp_errorgain = def.vp_errorgain;
+		vdata.sr_nvalue = def.sr_nvalue;
+	} else if (tx->flags & OPP_TX_SR) {
+		vdata.sr_errminlimit = tx->sr_errminlimit;
+		vdata.vp_errorgain = tx->vp_errorgain;
+		vdata.sr_nvalue = tx->sr_nvalue;
+	} else if ((tx->flags & OPP_TX_VOLT) && ops->sr_pinned &&
+		   ops->sr_pinned(priv, index, &def)) {
+		vdata.sr_errminlimit = def.sr_errminlimit;
+		vdata.vp_errorgain = def.vp_errorgain;
+		vdata.sr_nvalue = def.sr_nvalue;
+	}
+	if (tx->flags & OPP_TX_ABB) {
+		ops->get_default_vdata(priv, index, &def);
+		vdata.abb = (tx->abb == OPP_ABB_DEFAULT) ? def.abb : tx->abb;
+	}
+
+	/* Body bias going first has to be in place before anything else
+	 * changes. If the LDO doesn't confirm the switch, put the rate back
+	 * and fail the request. */
+	abb_late = 0;
+	if (active && (tx->flags & OPP_TX_ABB)) {
+		abb_late = (tx->flags & (OPP_TX_VOLT | OPP_TX_SR)) &&
+			   vdata.u_volt_calib > ops->vp_voltage(priv);
+		if (!abb_late) {
+			ret = opp_xition_abb(ops, priv, t, tx, vdata.abb);
+			if (ret) {
+				if (rate < old_rate)
+					ops->set_rate(priv, index, old_rate);
+				ops->unlock(priv);
+				return ret;
+			}
+		}
+	}
+
+	/* Editing the table alone leaves the MPU at the old rate. Move the
+	 * clock down before the rail follows, as opp_restore_entry() does,
+	 * or the old rate runs on the lowered voltage until the end. */
+	if (active && rate < old_rate) {
+		ops->sync_policy(priv);
+		ops->unlock(priv);
+		phase_start = opp_xition_start(ops, priv);
+		ops->update_policy(priv);
+		opp_xition_end(ops, priv, t, OPP_PHASE_POLICY, phase_start);
+		ops->lock(priv);
+	}
+
+	if ((tx->flags & OPP_TX_SR) && ops->sr_pin)
+		ops->sr_pin(priv, index, opp_xition_sr_reset(tx) ? NULL : &vdata);
+	if (tx->flags & (OPP_TX_VOLT | OPP_TX_SR | OPP_TX_ABB))
+		ops->set_vdata(priv, index, &vdata);
+
+	/* Move the rail to the calibrated voltage. The voltage processor has
+	 * the real current voltage, the table entry may hold a stale
+	 * calibration. Only scale if it actually changed. */
+	if (active && (tx->flags & (OPP_TX_VOLT | OPP_TX_SR))) {
+		vp = ops->vp_voltage(priv);
+		if (vdata.u_volt_calib != vp) {
+			phase_start = opp_xition_start(ops, priv);
+			ops->scale_voltage(priv, index, vp);
+			opp_xition_end(ops, priv, t, OPP_PHASE_VSCALE, phase_start);
+		}
+		/* Configure voltage controller for the new voltage level. */
+		phase_start = opp_xition_start(ops, priv);
+		ops->vc_setup(priv, vdata.u_volt_calib);
+		opp_xition_end(ops, priv, t, OPP_PHASE_VC_SETUP, phase_start);
+	}
+	/* The rail is up already and the clock hasn't moved yet, a late
+	 * switch that times out is left to abb_status to report. */
+	if (abb_late)
+		opp_xition_abb(ops, priv, t, tx, vdata.abb);
+
+	/* When increasing frequency: voltage was raised first (above),
+	 * now set the new frequency. This order prevents brownouts. */
+	if (rate > old_rate)
+		ops->set_rate(priv, index, rate);
+
+	ops->sync_policy(priv);
+	ops->unlock(priv);
+	if (rate != old_rate) {
+		snprintf(msg, sizeof(msg), "updated OPP%d rate to %lumhz ",
+			 index, rate / 1000000);
+		opp_xition_notice(ops, priv, msg);
+	}
+
+	/* Reset and recalibrate SmartReflex. This is critical after voltage changes.
+	 * SmartReflex is OMAP's adaptive voltage scaling system that adjusts voltage
+	 * based on silicon characteristics. After changing voltage/frequency, we
+	 * need to wipe old calibration data and let it recalibrate for the new settings. */
+	phase_start = opp_xition_start(ops, priv);
+	ops->sr_recal(priv);
+	opp_xition_end(ops, priv, t, OPP_PHASE_SR_RECAL, phase_start);
+
+	/* Update cpufreq policy. This propagates our direct structure modifications
+	 * to the actual hardware. This is what actually changes the CPU frequency. */
+	phase_start = opp_xition_start(ops, priv);
+	ops->update_policy(priv);
+	opp_xition_end(ops, priv, t, OPP_PHASE_POLICY, phase_start);
+
+	opp_xition_end(ops, priv, t, OPP_PHASE_TOTAL, start);
+
+	tx->applied_rate = ops->get_rate(priv, index);
+	tx->applied_u_volt = vdata.u_volt_calib;
+	tx->vp_volt = ops->vp_voltage(priv);
+	tx->duration_ns = t->ns[OPP_PHASE_TOTAL];
+	return 0;
+}
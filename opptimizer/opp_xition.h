@@ -0,0 +1,162 @@
+/*
+ * opp_xition.h - MPU OPP transition sequencing
+ *
+ * opp_xition_run() is the body of an OPP_IOC_TRANSITION request: it
+ * validates the request, edits the OPP and voltage tables, moves the
+ * rail and pushes the result through cpufreq, in the order that keeps
+ * the voltage ahead of the frequency. Every kernel call goes through
+ * struct opp_xition_ops, so the same sequence runs inside opptimizer.ko
+ * and in oppsim on a host against simulated OPP tables, voltage
+ * processor and cpufreq. Keep this file and opp_xition.c plain C for
+ * that reason.
+ */
+#ifndef _OPP_XITION_H_
+#define _OPP_XITION_H_
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/errno.h>
+#else
+#include <stdint.h>
+#include <errno.h>
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef uint64_t u64;
+#endif
+
+#include "opp_ioctl.h"
+
+enum opp_phase {
+	OPP_PHASE_VSCALE,	/* omap_voltage_scale() */
+	OPP_PHASE_VC_SETUP,	/* vc_setup_on_voltage() */
+	OPP_PHASE_SR_RECAL,	/* sr_class1p5_reset_calib() */
+	OPP_PHASE_POLICY,	/* cpufreq_update_policy() */
+	OPP_PHASE_ABB,		/* ABB LDO switch */
+	OPP_PHASE_TOTAL,	/* the whole transition */
+	OPP_PHASE_COUNT
+};
+
+/**
+ * struct opp_timing - phase durations of one transition
+ * @ns:		duration of each phase
+ * @ran:	bit (1 << phase) set for every phase that was executed,
+ *		phases that were skipped are not recorded
+ */
+struct opp_timing {
+	u64 ns[OPP_PHASE_COUNT];
+	unsigned int ran;
+};
+
+/* SmartReflex error min limit set with an explicit voltage, see
+ * opp_xition.c. The kernel default is 0xF9. */
+#define OPP_XITION_SR_ERRMINLIMIT	0x16
+
+/* What an OPP_TX_SR request may set. The error min limit is a signed
+ * 8 bit value: the 3630 tables use -12 (0xF4) to -6 (0xFA), the
+ * overclock default above is 22. The stock VP error gains are 0x0C to
+ * 0x27; 0xFF was tried and made the rail oscillate. The N target is 24
+ * bits, and zero would stop SmartReflex from ever converging. */
+#define OPP_XITION_ERRMINLIMIT_MIN	(-16)
+#define OPP_XITION_ERRMINLIMIT_MAX	31
+#define OPP_XITION_ERRORGAIN_MIN	0x01
+#define OPP_XITION_ERRORGAIN_MAX	0x3F
+#define OPP_XITION_NVALUE_MAX		0xFFFFFF
+
+/**
+ * struct opp_xition_vdata - the fields of struct omap_volt_data a
+ *	transition reads or writes
+ */
+struct opp_xition_vdata {
+	unsigned long u_volt_calib;
+	unsigned long u_volt_dyn_nominal;
+	unsigned long u_volt_dyn_margin;
+	u8 sr_errminlimit;
+	u8 vp_errorgain;
+	u32 sr_nvalue;
+	u8 abb;
+};
+
+/**
+ * struct opp_xition_limits - what a request may ask for
+ * @count:		MPU OPPs, valid indices are 0 .. count - 1
+ * @rate_min:		lowest rate of OPP 0
+ * @rate_min_low:	lowest rate of the other OPPs
+ * @rate_max:		highest rate of any OPP
+ * @volt_min:		voltages below are raised to this
+ * @volt_max:		voltages above are lowered to this
+ */
+struct opp_xition_limits {
+	int count;
+	unsigned long rate_min;
+	unsigned long rate_min_low;
+	unsigned long rate_max;
+	unsigned long volt_min;
+	unsigned long volt_max;
+};
+
+/**
+ * struct opp_xition_ops - what opp_xition_run() needs from its caller
+ * @get_rate:		rate of OPP @index
+ * @set_rate:		change the rate of OPP @index in the OPP and
+ *			cpufreq tables, the clock is not touched
+ * @active_index:	OPP the MPU runs at, -1 if unknown
+ * @save_vdata:		copy the voltage table entry of OPP @index before
+ *			it is edited. The caller keeps its own full copy,
+ *			scale_voltage() moves the rail away from it
+ * @get_default_vdata:	the entry as it was at module load
+ * @set_vdata:		write the entry of OPP @index
+ * @vp_voltage:		voltage the VDD1 voltage processor is at
+ * @scale_voltage:	move the rail to the entry of OPP @index, from the
+ *			saved copy with @u_volt_current as its voltage
+ * @vc_setup:		set the voltage controller up for @u_volt
+ * @lock:		keep the kernel's DVFS out, held around every table
+ *			edit and rail move
+ * @unlock:		let it back in
+ * @sync_policy:	recompute the cpufreq limits from the OPP table
+ * @sr_recal:		reset and recalibrate SmartReflex on VDD1
+ * @update_policy:	push the policy through cpufreq, which is when the
+ *			MPU clock actually moves
+ * @now_ns:		monotonic time for the phase timing
+ * @notice:		log a message, may be NULL
+ * @sr_pinned:		fill the SmartReflex fields of @v with the values an
+ *			earlier OPP_TX_SR request pinned to OPP @index and
+ *			return non-zero, or return 0. May be NULL
+ * @sr_pin:		pin the SmartReflex fields of @v to OPP @index, NULL
+ *			unpins. May be NULL
+ * @abb_switch:		switch the VDD1 ABB LDO to forward body bias if @fbb
+ *			is set, to bypass if not. Returns 0 once the LDO
+ *			reports done, 1 if it was in that mode already,
+ *			or -ETIMEDOUT. May be NULL, OPP_TX_ABB requests
+ *			then fail with -ENODEV
+ */
+struct opp_xition_ops {
+	unsigned long (*get_rate)(void *priv, int index);
+	void (*set_rate)(void *priv, int index, unsigned long rate);
+	int (*active_index)(void *priv);
+	void (*save_vdata)(void *priv, int index, struct opp_xition_vdata *v);
+	void (*get_default_vdata)(void *priv, int index, struct opp_xition_vdata *v);
+	void (*set_vdata)(void *priv, int index, const struct opp_xition_vdata *v);
+	unsigned long (*vp_voltage)(void *priv);
+	void (*scale_voltage)(void *priv, int index, unsigned long u_volt_current);
+	void (*vc_setup)(void *priv, unsigned long u_volt);
+	void (*lock)(void *priv);
+	void (*unlock)(void *priv);
+	void (*sync_policy)(void *priv);
+	void (*sr_recal)(void *priv);
+	void (*update_policy)(void *priv);
+	u64 (*now_ns)(void *priv);
+	void (*notice)(void *priv, const char *msg);
+	int (*sr_pinned)(void *priv, int index, struct opp_xition_vdata *v);
+	void (*sr_pin)(void *priv, int index, const struct opp_xition_vdata *v);
+	int (*abb_switch)(void *priv, int fbb);
+};
+
+int opp_xition_check_rate(const struct opp_xition_ops *ops, void *priv,
+			  const struct opp_xition_limits *lim,
+			  int index, unsigned long rate);
+int opp_xition_check_sr(const struct opp_ioc_transition *tx);
+int opp_xition_run(const struct opp_xition_ops *ops, void *priv,
+		   const struct opp_xition_limits *lim,
+		   struct opp_ioc_transition *tx, struct opp_timing *t);
+
+#endif
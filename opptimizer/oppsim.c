@@ -0,0 +1,653 @@
+/* oppsim.c - run OPP transitions against a simulated OMAP3630
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Host tool, not shipped in the package. It links the same opp_xition.c
+ * opptimizer.ko uses and supplies every kernel call it makes: the MPU OPP
+ * table, the VDD1 voltage table, the voltage processor, SmartReflex and
+ * cpufreq, each taking a configurable time. Transition sequences can be
+ * benchmarked and checked on any Linux box.
+ *
+ * The simulated chip needs vmin(f) = offset + slope * f(MHz) on VDD1 to
+ * run at f. The run fails (exit status 1) if the rail is ever below what
+ * the OPP the MPU runs at needs:
+ *  - a rate raised in the table before the rail was raised for it
+ *  - the rail moved below what the current rate needs
+ *  - the clock moved to a rate the rail doesn't cover
+ * or if a table is edited without the DVFS lock held.
+ *
+ * Forward body bias lowers vmin by SIM_FBB_UV while the ABB LDO is in
+ * FBB, so the same checks catch bias removed too early or switched on
+ * only after the rail went below what the OPP needs without it. Like
+ * on the 3630 only the top stock OPP uses FBB.
+ *
+ * Input, one command per line, '#' starts a comment:
+ *     opp <n> <rate Hz> <uV> [<abb>]
+ *                                 replace OPP n before the first transition
+ *     run <n>                     the MPU moves to OPP n, as cpufreq would
+ *     tx <n> <rate Hz|-> <uV|-> [<nvalue> <errminlimit> <errorgain>]
+ *        [abb <0|1|default>]
+ * A '-' leaves that input out of the request, a voltage of 0 returns
+ * the OPP to its default voltage, as with /proc/opptimizer. SmartReflex
+ * values stay pinned to the OPP until a request with all three 0.
+ *
+ * Output is CSV on stdout, one line per transition:
+ *     line,index,ret,rate,u_volt,vp_uv,clk_khz,clamped,total_us,
+ *     vscale_us,vc_setup_us,sr_recal_us,policy_us,abb_us,abb_status
+ * followed by a summary on stderr.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "opp_xition.h"
+
+/*
+ * Local definitions
+ */
+
+#define SIM_OPP_MAX         16
+#define SIM_LINE_MAX        256
+
+/* Same limits as opp_core.c */
+#define SIM_RATE_MAX        1700000000UL
+#define SIM_RATE_MIN        800000000UL
+#define SIM_RATE_MIN_LOW    100000000UL
+#define SIM_VOLT_MAX        1425000UL
+#define SIM_VOLT_MIN        1000000UL
+
+/* Stock VDD1 OPPs of the 3630, highest first like mpu_opps[] */
+#define SIM_DEF_COUNT       4
+static const unsigned long sim_def_rate[SIM_DEF_COUNT] = {
+    1000000000, 800000000, 600000000, 300000000
+};
+static const unsigned long sim_def_uv[SIM_DEF_COUNT] = {
+    1375000, 1325000, 1200000, 1012500
+};
+static const int sim_def_abb[SIM_DEF_COUNT] = {
+    1, 0, 0, 0
+};
+
+#define SIM_DEF_VMIN_OFFSET 850000      /* uV */
+#define SIM_DEF_VMIN_SLOPE  500         /* uV per MHz */
+#define SIM_FBB_UV          50000       /* vmin saved by forward body bias */
+
+/* Default op latencies in us, roughly what opptimizer/latency reports */
+#define SIM_DEF_VSCALE_US   150
+#define SIM_DEF_VC_US       10
+#define SIM_DEF_SR_US       300
+#define SIM_DEF_POLICY_US   400
+#define SIM_DEF_ABB_US      30
+
+struct sim {
+    int count;
+    unsigned long rate[SIM_OPP_MAX];
+    struct opp_xition_vdata vdata[SIM_OPP_MAX];
+    struct opp_xition_vdata def[SIM_OPP_MAX];
+    struct opp_xition_vdata pin[SIM_OPP_MAX];
+    int pinned[SIM_OPP_MAX];
+    int active;
+    int locked;
+    int fbb;
+    unsigned long vp_uv;
+    unsigned long clk_hz;
+    u64 now_ns;
+
+    unsigned long vmin_offset;
+    unsigned long vmin_slope;
+    u64 vscale_ns, vc_ns, sr_ns, policy_ns, abb_ns;
+
+    unsigned long lineno;
+    unsigned int violations;
+    int quiet;
+};
+
+/*
+ * Support functions
+ */
+
+static void sim_usage(const char *appName)
+{
+    fprintf(stderr,
+        "usage: %s [-m offset_uv,uv_per_mhz] [-l vscale,vc,sr,policy (us)]\n"
+        "       [-b repeat] [-q] < script\n",
+        appName);
+}
+
+static unsigned long sim_vmin(const struct sim *s, unsigned long rate)
+{
+    unsigned long vmin = s->vmin_offset + s->vmin_slope * (rate / 1000000);
+
+    return s->fbb ? vmin - SIM_FBB_UV : vmin;
+}
+
+static void sim_violation(struct sim *s, const char *what, unsigned long rate)
+{
+    s->violations++;
+    if (!s->quiet)
+        fprintf(stderr, "line %lu: %s: %lu uV at %lu Hz, needs %lu uV\n",
+            s->lineno, what, s->vp_uv, rate, sim_vmin(s, rate));
+}
+
+static void sim_check_locked(struct sim *s, const char *op)
+{
+    if (!s->locked) {
+        s->violations++;
+        if (!s->quiet)
+            fprintf(stderr, "line %lu: %s without the DVFS lock\n", s->lineno, op);
+    }
+}
+
+/*
+ * Simulated kernel, see struct opp_xition_ops
+ */
+
+static unsigned long sim_get_rate(void *priv, int index)
+{
+    struct sim *s = priv;
+
+    return s->rate[index];
+}
+
+static void sim_set_rate(void *priv, int index, unsigned long rate)
+{
+    struct sim *s = priv;
+
+    sim_check_locked(s, "set_rate");
+    s->rate[index] = rate;
+    /* The kernel's DVFS may switch to the new rate as soon as it can get
+     * in, so the rail has to cover it from here on */
+    if (index == s->active && s->vp_uv < sim_vmin(s, rate))
+        sim_violation(s, "rate raised before the voltage", rate);
+}
+
+static int sim_active_index(void *priv)
+{
+    struct sim *s = priv;
+
+    return s->active;
+}
+
+static void sim_save_vdata(void *priv, int index, struct opp_xition_vdata *v)
+{
+    struct sim *s = priv;
+
+    *v = s->vdata[index];
+}
+
+static void sim_get_default_vdata(void *priv, int index, struct opp_xition_vdata *v)
+{
+    struct sim *s = priv;
+
+    *v = s->def[index];
+}
+
+static void sim_set_vdata(void *priv, int index, const struct opp_xition_vdata *v)
+{
+    struct sim *s = priv;
+
+    sim_check_locked(s, "set_vdata");
+    s->vdata[index] = *v;
+}
+
+static unsigned long sim_vp_voltage(void *priv)
+{
+    struct sim *s = priv;
+
+    return s->vp_uv;
+}
+
+static void sim_scale_voltage(void *priv, int index, unsigned long u_volt_current)
+{
+    struct sim *s = priv;
+
+    sim_check_locked(s, "scale_voltage");
+    s->vp_uv = s->vdata[index].u_volt_calib;
+    s->now_ns += s->vscale_ns;
+    if (s->vp_uv < sim_vmin(s, s->clk_hz))
+        sim_violation(s, "voltage lowered below the running rate", s->clk_hz);
+    if (s->vp_uv < sim_vmin(s, s->rate[s->active]))
+        sim_violation(s, "voltage lowered before the rate", s->rate[s->active]);
+}
+
+static void sim_vc_setup(void *priv, unsigned long u_volt)
+{
+    struct sim *s = priv;
+
+    s->now_ns += s->vc_ns;
+}
+
+static void sim_lock(void *priv)
+{
+    struct sim *s = priv;
+
+    s->locked = 1;
+}
+
+static void sim_unlock(void *priv)
+{
+    struct sim *s = priv;
+
+    s->locked = 0;
+}
+
+static void sim_sync_policy(void *priv)
+{
+    struct sim *s = priv;
+
+    sim_check_locked(s, "sync_policy");
+}
+
+static void sim_sr_recal(void *priv)
+{
+    struct sim *s = priv;
+
+    s->now_ns += s->sr_ns;
+}
+
+/* cpufreq keeps the MPU on the same table entry, at its new rate */
+static void sim_update_policy(void *priv)
+{
+    struct sim *s = priv;
+
+    s->now_ns += s->policy_ns;
+    s->clk_hz = s->rate[s->active];
+    if (s->vp_uv < sim_vmin(s, s->clk_hz))
+        sim_violation(s, "clock moved above the voltage", s->clk_hz);
+}
+
+static u64 sim_now_ns(void *priv)
+{
+    struct sim *s = priv;
+
+    return s->now_ns;
+}
+
+static void sim_notice(void *priv, const char *msg)
+{
+    struct sim *s = priv;
+
+    if (!s->quiet)
+        fprintf(stderr, "line %lu: %s\n", s->lineno, msg);
+}
+
+static int sim_sr_pinned(void *priv, int index, struct opp_xition_vdata *v)
+{
+    struct sim *s = priv;
+
+    if (s->pinned[index])
+        *v = s->pin[index];
+    return s->pinned[index];
+}
+
+static void sim_sr_pin(void *priv, int index, const struct opp_xition_vdata *v)
+{
+    struct sim *s = priv;
+
+    s->pinned[index] = v != NULL;
+    if (v != NULL)
+        s->pin[index] = *v;
+}
+
+static int sim_abb_switch(void *priv, int fbb)
+{
+    struct sim *s = priv;
+
+    sim_check_locked(s, "abb_switch");
+    if (s->fbb == !!fbb)
+        return 1;
+    s->fbb = !!fbb;
+    s->now_ns += s->abb_ns;
+    if (s->vp_uv < sim_vmin(s, s->clk_hz))
+        sim_violation(s, "body bias removed below the running rate", s->clk_hz);
+    return 0;
+}
+
+static const struct opp_xition_ops sim_ops = {
+    sim_get_rate,
+    sim_set_rate,
+    sim_active_index,
+    sim_save_vdata,
+    sim_get_default_vdata,
+    sim_set_vdata,
+    sim_vp_voltage,
+    sim_scale_voltage,
+    sim_vc_setup,
+    sim_lock,
+    sim_unlock,
+    sim_sync_policy,
+    sim_sr_recal,
+    sim_update_policy,
+    sim_now_ns,
+    sim_notice,
+    sim_sr_pinned,
+    sim_sr_pin,
+    sim_abb_switch,
+};
+
+static void sim_set_opp(struct sim *s, int n, unsigned long rate, unsigned long uv,
+                        int abb)
+{
+    s->rate[n] = rate;
+    s->vdata[n].u_volt_calib = uv;
+    s->vdata[n].u_volt_dyn_nominal = uv;
+    s->vdata[n].u_volt_dyn_margin = 0;
+    s->vdata[n].sr_errminlimit = 0xF9;
+    s->vdata[n].vp_errorgain = 0x16;
+    s->vdata[n].sr_nvalue = 0x999999;
+    s->vdata[n].abb = abb;
+    s->def[n] = s->vdata[n];
+    s->pinned[n] = 0;
+}
+
+static void sim_reset(struct sim *s)
+{
+    int i;
+
+    s->count = SIM_DEF_COUNT;
+    for (i = 0; i < SIM_DEF_COUNT; i++)
+        sim_set_opp(s, i, sim_def_rate[i], sim_def_uv[i], sim_def_abb[i]);
+    s->active = 0;
+    s->locked = 0;
+    s->fbb = s->vdata[0].abb;
+    s->vp_uv = s->vdata[0].u_volt_calib;
+    s->clk_hz = s->rate[0];
+    s->now_ns = 0;
+}
+
+/* "-" leaves a field out, returns 0 for it and 1 for a number */
+static int sim_field(const char *f, unsigned long *out)
+{
+    char *end;
+
+    if (strcmp(f, "-") == 0)
+        return 0;
+    errno = 0;
+    *out = strtoul(f, &end, 0);
+    if (errno != 0 || end == f || *end != '\0')
+        return -EINVAL;
+    return 1;
+}
+
+static int sim_parse_us(const char *s, u64 *vscale, u64 *vc, u64 *sr, u64 *policy)
+{
+    unsigned long a, b, c, d;
+
+    if (sscanf(s, "%lu,%lu,%lu,%lu", &a, &b, &c, &d) != 4)
+        return -EINVAL;
+    *vscale = (u64)a * 1000;
+    *vc = (u64)b * 1000;
+    *sr = (u64)c * 1000;
+    *policy = (u64)d * 1000;
+    return 0;
+}
+
+static u64 sim_host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Script
+ */
+
+struct sim_totals {
+    unsigned long transitions;
+    unsigned long failed;
+    u64 sim_ns;
+    u64 host_ns;
+};
+
+static int sim_tx(struct sim *s, char **f, int nf, struct sim_totals *tot, int print)
+{
+    struct opp_xition_limits lim;
+    struct opp_ioc_transition tx;
+    struct opp_timing t;
+    unsigned long n, v;
+    u64 host;
+    int r, ret;
+
+    memset(&tx, 0, sizeof(tx));
+    tx.version = OPP_IOC_VERSION;
+    if ((nf == 6 || nf == 9) && strcmp(f[nf - 2], "abb") == 0) {
+        tx.flags |= OPP_TX_ABB;
+        if (strcmp(f[nf - 1], "default") == 0)
+            tx.abb = OPP_ABB_DEFAULT;
+        else if (sim_field(f[nf - 1], &v) == 1)
+            tx.abb = v;
+        else
+            return -EINVAL;
+        nf -= 2;
+    }
+    if (nf != 4 && nf != 7)
+        return -EINVAL;
+    if (sim_field(f[1], &n) != 1)
+        return -EINVAL;
+    tx.index = n;
+    r = sim_field(f[2], &v);
+    if (r < 0)
+        return r;
+    if (r) {
+        tx.flags |= OPP_TX_RATE;
+        tx.rate = v;
+    }
+    r = sim_field(f[3], &v);
+    if (r < 0)
+        return r;
+    if (r) {
+        tx.flags |= OPP_TX_VOLT;
+        tx.u_volt = v;
+    }
+    if (nf == 7) {
+        tx.flags |= OPP_TX_SR;
+        if (sim_field(f[4], &v) != 1)
+            return -EINVAL;
+        tx.sr_nvalue = v;
+        if (sim_field(f[5], &v) != 1)
+            return -EINVAL;
+        tx.sr_errminlimit = v;
+        if (sim_field(f[6], &v) != 1)
+            return -EINVAL;
+        tx.vp_errorgain = v;
+    }
+
+    lim.count = s->count;
+    lim.rate_min = SIM_RATE_MIN;
+    lim.rate_min_low = SIM_RATE_MIN_LOW;
+    lim.rate_max = SIM_RATE_MAX;
+    lim.volt_min = SIM_VOLT_MIN;
+    lim.volt_max = SIM_VOLT_MAX;
+
+    host = sim_host_ns();
+    ret = opp_xition_run(&sim_ops, s, &lim, &tx, &t);
+    tot->host_ns += sim_host_ns() - host;
+    tot->transitions++;
+    if (ret) {
+        tot->failed++;
+        memset(&t, 0, sizeof(t));
+    }
+    tot->sim_ns += t.ns[OPP_PHASE_TOTAL];
+
+    if (print)
+        printf("%lu,%lu,%d,%lu,%lu,%lu,%lu,%u,%llu,%llu,%llu,%llu,%llu,%llu,%u\n",
+            s->lineno, n, ret, (unsigned long)tx.applied_rate,
+            (unsigned long)tx.applied_u_volt, s->vp_uv, s->clk_hz / 1000,
+            (unsigned int)tx.clamped,
+            (unsigned long long)t.ns[OPP_PHASE_TOTAL] / 1000,
+            (unsigned long long)t.ns[OPP_PHASE_VSCALE] / 1000,
+            (unsigned long long)t.ns[OPP_PHASE_VC_SETUP] / 1000,
+            (unsigned long long)t.ns[OPP_PHASE_SR_RECAL] / 1000,
+            (unsigned long long)t.ns[OPP_PHASE_POLICY] / 1000,
+            (unsigned long long)t.ns[OPP_PHASE_ABB] / 1000,
+            (unsigned int)tx.abb_status);
+    return 0;
+}
+
+/* Moving to another OPP is cpufreq's job and not what is simulated,
+ * the rail and the clock simply arrive there together */
+static int sim_run(struct sim *s, char **f, int nf)
+{
+    unsigned long n;
+
+    if (nf != 2 || sim_field(f[1], &n) != 1 || n >= (unsigned long)s->count)
+        return -EINVAL;
+    s->active = n;
+    s->clk_hz = s->rate[n];
+    s->vp_uv = s->vdata[n].u_volt_calib;
+    s->fbb = s->vdata[n].abb;
+    if (s->vp_uv < sim_vmin(s, s->clk_hz))
+        sim_violation(s, "OPP runs below its voltage", s->clk_hz);
+    return 0;
+}
+
+static int sim_opp(struct sim *s, char **f, int nf, int started)
+{
+    unsigned long n, rate, uv, abb = 0;
+
+    if (started || (nf != 4 && nf != 5) || sim_field(f[1], &n) != 1 ||
+        n >= SIM_OPP_MAX || sim_field(f[2], &rate) != 1 ||
+        sim_field(f[3], &uv) != 1 || (nf == 5 && sim_field(f[4], &abb) != 1) ||
+        abb > 1)
+        return -EINVAL;
+    sim_set_opp(s, n, rate, uv, abb);
+    if ((int)n >= s->count)
+        s->count = n + 1;
+    if ((int)n == s->active) {
+        s->clk_hz = rate;
+        s->vp_uv = uv;
+        s->fbb = abb;
+    }
+    return 0;
+}
+
+static int sim_script(struct sim *s, char **lines, int nlines,
+                      struct sim_totals *tot, int print)
+{
+    char line[SIM_LINE_MAX];
+    char *f[10], *hash, *tok;
+    int i, nf, ret, started = 0;
+
+    sim_reset(s);
+    for (i = 0; i < nlines; i++) {
+        s->lineno = i + 1;
+        strcpy(line, lines[i]);
+        hash = strchr(line, '#');
+        if (hash != NULL)
+            *hash = '\0';
+        nf = 0;
+        for (tok = strtok(line, " \t\r\n"); tok != NULL && nf < 10;
+             tok = strtok(NULL, " \t\r\n"))
+            f[nf++] = tok;
+        if (nf == 0)
+            continue;
+
+        if (strcmp(f[0], "opp") == 0) {
+            ret = sim_opp(s, f, nf, started);
+        } else if (strcmp(f[0], "run") == 0) {
+            ret = sim_run(s, f, nf);
+        } else if (strcmp(f[0], "tx") == 0) {
+            started = 1;
+            ret = sim_tx(s, f, nf, tot, print);
+        } else {
+            ret = -EINVAL;
+        }
+        if (ret < 0) {
+            fprintf(stderr, "line %lu: can't parse\n", s->lineno);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Entry point
+ */
+
+int main(int argc, char *argv[])
+{
+    const char *appName = argv[0];
+    struct sim s;
+    struct sim_totals tot;
+    char line[SIM_LINE_MAX];
+    char **lines = NULL;
+    unsigned int repeat = 1, violations = 0, i;
+    int nlines = 0, opt, rv = 0;
+
+    memset(&s, 0, sizeof(s));
+    memset(&tot, 0, sizeof(tot));
+    s.vmin_offset = SIM_DEF_VMIN_OFFSET;
+    s.vmin_slope = SIM_DEF_VMIN_SLOPE;
+    s.vscale_ns = SIM_DEF_VSCALE_US * 1000;
+    s.vc_ns = SIM_DEF_VC_US * 1000;
+    s.sr_ns = SIM_DEF_SR_US * 1000;
+    s.policy_ns = SIM_DEF_POLICY_US * 1000;
+    s.abb_ns = SIM_DEF_ABB_US * 1000;
+
+    while ((opt = getopt(argc, argv, "m:l:b:q")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (sscanf(optarg, "%lu,%lu", &s.vmin_offset, &s.vmin_slope) != 2)
+                rv = -EINVAL;
+            break;
+        case 'l':
+            rv = sim_parse_us(optarg, &s.vscale_ns, &s.vc_ns, &s.sr_ns, &s.policy_ns);
+            break;
+        case 'b':
+            if (sscanf(optarg, "%u", &repeat) != 1 || repeat == 0)
+                rv = -EINVAL;
+            break;
+        case 'q':
+            s.quiet = 1;
+            break;
+        default:
+            rv = -EINVAL;
+            break;
+        }
+        if (rv < 0) {
+            sim_usage(appName);
+            return 2;
+        }
+    }
+
+    /* The whole script is kept so that -b can replay it */
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        lines = realloc(lines, (nlines + 1) * sizeof(*lines));
+        if (lines == NULL) {
+            fprintf(stderr, "%s: out of memory\n", appName);
+            return 2;
+        }
+        lines[nlines] = malloc(strlen(line) + 1);
+        if (lines[nlines] == NULL) {
+            fprintf(stderr, "%s: out of memory\n", appName);
+            return 2;
+        }
+        strcpy(lines[nlines++], line);
+    }
+
+    printf("line,index,ret,rate,u_volt,vp_uv,clk_khz,clamped,total_us,"
+        "vscale_us,vc_setup_us,sr_recal_us,policy_us,abb_us,abb_status\n");
+    for (i = 0; i < repeat; i++) {
+        if (sim_script(&s, lines, nlines, &tot, i == 0) < 0)
+            return 2;
+        /* Only the first pass reports, the rest are for timing */
+        if (i == 0)
+            violations = s.violations;
+        s.quiet = 1;
+    }
+
+    fprintf(stderr, "transitions=%lu failed=%lu violations=%u sim_us=%llu host_ns_per_tx=%llu\n",
+        tot.transitions / repeat, tot.failed / repeat, violations,
+        (unsigned long long)(tot.sim_ns / repeat / 1000),
+        (unsigned long long)(tot.transitions ? tot.host_ns / tot.transitions : 0));
+    return violations ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+/* thermsim.c - run the thermal guard against a simulated temperature
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Host tool, not shipped in the package. It links the same opp_thermal.c
+ * opptimizer.ko uses and feeds a fixed temperature trace through
+ * opp_thermal_step(), checking the state and rate cap after every
+ * sample: trips entered on the way up, left only hyst_mc below, several
+ * crossed in one sample, and the time charged to each state. It also
+ * checks the trip table validation and the bandgap ADC conversion.
+ *
+ * -v prints every sample. Exit status is 0 if every case matches, 1
+ * otherwise.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "opp_thermal.h"
+
+/*
+ * Local definitions
+ */
+
+/* Same trip table as opp_core.c */
+static const struct opp_thermal_params th_params = {
+    {
+        { 80000, 1000000 },
+        { 90000, 800000 },
+    },
+    2,
+    5000,
+};
+
+struct th_sample {
+    int temp_mc;
+    unsigned int dt_ms;
+    int state;                  /* expected after the sample */
+    unsigned int cap_khz;
+};
+
+static const struct th_sample th_trace[] = {
+    { 70000, 1000, 0, 0 },
+    { 79999, 1000, 0, 0 },
+    { 80000, 1000, 1, 1000000 },        /* trip reached */
+    { 76000, 1000, 1, 1000000 },        /* inside the hysteresis */
+    { 75000, 1000, 1, 1000000 },        /* at its edge */
+    { 74999, 1000, 0, 0 },              /* below it */
+    { 80000, 500, 1, 1000000 },
+    { 95000, 500, 2, 800000 },
+    { 86000, 2000, 2, 800000 },
+    { 84999, 1000, 1, 1000000 },
+    { 95000, 1000, 2, 800000 },
+    { 60000, 1000, 0, 0 },              /* both trips left at once */
+    { 91000, 1000, 2, 800000 },         /* both entered at once */
+};
+
+/* Time in each state once the trace has run: every interval is charged
+ * to the state the guard was in before its sample */
+static const unsigned int th_state_ms[] = { 4500, 4500, 4000 };
+#define TH_CHANGES          8
+
+struct th_adc {
+    unsigned int adc;
+    int temp_mc;
+};
+
+static const struct th_adc th_adcs[] = {
+    { 0, -40000 },
+    { 26, -40000 },
+    { 27, -38000 },
+    { 28, -36370 },
+    { 77, 43500 },
+    { 127, 125000 },
+    { 200, 125000 },
+};
+
+#define TH_COUNT(a)         ((int)(sizeof(a) / sizeof((a)[0])))
+
+static int verbose;
+
+/*
+ * Support functions
+ */
+
+static void th_usage(const char *appName)
+{
+    fprintf(stderr, "usage: %s [-v]\n", appName);
+}
+
+static int th_trace_run(int *total)
+{
+    struct opp_thermal t;
+    struct opp_thermal_params shrunk;
+    unsigned int cap;
+    int i, state, failed = 0;
+
+    opp_thermal_init(&t, &th_params);
+    for (i = 0; i < TH_COUNT(th_trace); i++, (*total)++) {
+        state = opp_thermal_step(&t, th_trace[i].temp_mc, th_trace[i].dt_ms);
+        cap = opp_thermal_cap_khz(&t);
+        if (verbose)
+            printf("    %dmC: state %d cap %u\n", th_trace[i].temp_mc, state, cap);
+        if (state != th_trace[i].state || t.state != state ||
+            cap != th_trace[i].cap_khz || t.last_mc != th_trace[i].temp_mc) {
+            printf("# FAIL: sample %d, %dmC: state %d cap %u, expected %d %u\n",
+                i, th_trace[i].temp_mc, state, cap, th_trace[i].state,
+                th_trace[i].cap_khz);
+            failed++;
+        }
+    }
+
+    (*total)++;
+    for (i = 0; i < TH_COUNT(th_state_ms); i++) {
+        if (t.state_ms[i] != th_state_ms[i]) {
+            printf("# FAIL: %llums in state %d, expected %u\n",
+                (unsigned long long)t.state_ms[i], i, th_state_ms[i]);
+            failed++;
+            break;
+        }
+    }
+    (*total)++;
+    if (t.changes != TH_CHANGES) {
+        printf("# FAIL: %u state changes, expected %d\n", t.changes, TH_CHANGES);
+        failed++;
+    }
+
+    /* Dropping a trip while it is in effect lands on the last one left,
+     * without waiting for the temperature to fall */
+    (*total)++;
+    shrunk = th_params;
+    shrunk.count = 1;
+    t.p = &shrunk;
+    state = opp_thermal_step(&t, 91000, 0);
+    if (state != 1 || opp_thermal_cap_khz(&t) != 1000000) {
+        printf("# FAIL: shrunk table, state %d cap %u\n", state,
+            opp_thermal_cap_khz(&t));
+        failed++;
+    }
+    return failed;
+}
+
+static int th_params_check(int *total)
+{
+    struct opp_thermal_params p;
+    int failed = 0;
+
+    *total += 5;
+    if (!opp_thermal_params_valid(&th_params)) {
+        printf("# FAIL: default trips refused\n");
+        failed++;
+    }
+    p = th_params;
+    p.hyst_mc = 10000;
+    if (opp_thermal_params_valid(&p)) {
+        printf("# FAIL: hysteresis reaching the trip below accepted\n");
+        failed++;
+    }
+    p = th_params;
+    p.trips[1].cap_khz = 1200000;
+    if (opp_thermal_params_valid(&p)) {
+        printf("# FAIL: rising cap accepted\n");
+        failed++;
+    }
+    p = th_params;
+    p.trips[0].cap_khz = 0;
+    if (opp_thermal_params_valid(&p)) {
+        printf("# FAIL: zero cap accepted\n");
+        failed++;
+    }
+    p = th_params;
+    p.count = OPP_THERMAL_MAX_TRIPS + 1;
+    if (opp_thermal_params_valid(&p)) {
+        printf("# FAIL: too many trips accepted\n");
+        failed++;
+    }
+    return failed;
+}
+
+static int th_adc_check(int *total)
+{
+    unsigned int adc;
+    int i, mc, failed = 0;
+
+    for (i = 0; i < TH_COUNT(th_adcs); i++, (*total)++) {
+        mc = opp_thermal_adc_to_mc(th_adcs[i].adc);
+        if (verbose)
+            printf("    adc %u: %dmC\n", th_adcs[i].adc, mc);
+        if (mc != th_adcs[i].temp_mc) {
+            printf("# FAIL: adc %u: %dmC, expected %d\n", th_adcs[i].adc, mc,
+                th_adcs[i].temp_mc);
+            failed++;
+        }
+    }
+
+    /* A hotter die never reads as cooler */
+    (*total)++;
+    for (adc = 1; adc < 128; adc++) {
+        if (opp_thermal_adc_to_mc(adc) < opp_thermal_adc_to_mc(adc - 1)) {
+            printf("# FAIL: adc %u reads cooler than %u\n", adc, adc - 1);
+            failed++;
+            break;
+        }
+    }
+    return failed;
+}
+
+/*
+ * Entry point
+ */
+
+int main(int argc, char *argv[])
+{
+    const char *appName = argv[0];
+    int opt, failed = 0, total = 0;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            th_usage(appName);
+            return 2;
+        }
+    }
+
+    failed += th_trace_run(&total);
+    failed += th_params_check(&total);
+    failed += th_adc_check(&total);
+
+    fprintf(stderr, "%d of %d cases passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
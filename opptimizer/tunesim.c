@@ -0,0 +1,264 @@
+/* tunesim.c - run the undervolt search against a simulated MPU
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Host tool, not shipped in the package. It links the same opp_tune.c
+ * opptimizer.ko uses and puts opp_tune_run() through a fixed set of
+ * searches. The simulated MPU passes a verification at or above its
+ * vmin and fails below it; set_voltage and should_stop can be told to
+ * fail or fire at a given point. Every case checks the result against
+ * the expected one and that the search never left the limits it was
+ * given or left the OPP at a voltage other than the one it reports.
+ * The verification workloads are checked against their references too.
+ *
+ * -v prints every voltage set and verified. Exit status is 0 if every
+ * case matches, 1 otherwise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "opp_tune.h"
+
+/*
+ * Local definitions
+ */
+
+/* Same limits as opp_core.c */
+#define TS_VOLT_MAX         1425000UL
+#define TS_VOLT_MIN         1000000UL
+
+#define TS_MEM_WORDS        4096
+#define TS_SEED             0x5EED0123
+#define TS_ROUNDS           1024
+
+struct ts_case {
+    const char *name;
+    unsigned long calib_uv;     /* passed to opp_tune_init_params() */
+    unsigned long vmin_uv;      /* verify fails below this */
+    int verify_err;             /* what a failing verify returns */
+    unsigned int stop_after;    /* should_stop() after this many passes, 0 = never */
+    unsigned long bad_set_uv;   /* set_voltage() fails for this, 0 = never */
+
+    enum opp_tune_status status;
+    unsigned long min_stable_uv;
+    unsigned long failed_uv;
+    unsigned long applied_uv;
+    unsigned int steps;
+    int error;
+};
+
+static const struct ts_case ts_cases[] = {
+    { "fail below vmin, back off", 1375000, 1300000, -EIO, 0, 0,
+      OPP_TUNE_OK, 1300000, 1287500, 1325000, 8, -EIO },
+    { "timeout counts as a failure", 1375000, 1300000, -ETIMEDOUT, 0, 0,
+      OPP_TUNE_OK, 1300000, 1287500, 1325000, 8, -ETIMEDOUT },
+    { "start above ceiling, back off capped", 1450000, 1412500, -EIO, 0, 0,
+      OPP_TUNE_OK, 1412500, 1400000, 1425000, 3, -EIO },
+    { "unstable at start", 1375000, 1400000, -EIO, 0, 0,
+      OPP_TUNE_UNSTABLE, 0, 1375000, 1375000, 1, -EIO },
+    { "floor reached", 1050000, 0, -EIO, 0, 0,
+      OPP_TUNE_FLOOR, 1000000, 0, 1025000, 5, 0 },
+    { "start below floor", 950000, 0, -EIO, 0, 0,
+      OPP_TUNE_FLOOR, 1000000, 0, 1025000, 1, 0 },
+    { "aborted, back off", 1375000, 0, -EIO, 3, 0,
+      OPP_TUNE_ABORTED, 1350000, 0, 1375000, 3, 0 },
+    { "set_voltage fails during search", 1375000, 0, -EIO, 0, 1350000,
+      OPP_TUNE_ERROR, 1362500, 0, 1387500, 2, -EINVAL },
+    { "set_voltage fails at start", 1375000, 0, -EIO, 0, 1375000,
+      OPP_TUNE_ERROR, 0, 0, 0, 0, -EINVAL },
+};
+
+#define TS_COUNT(a)         ((int)(sizeof(a) / sizeof((a)[0])))
+
+/* The simulated MPU and what the search did to it */
+struct ts_mpu {
+    const struct ts_case *c;
+    unsigned long u_volt;       /* 0 until the first set */
+    unsigned long lowest_set, highest_set, lowest_verified;
+    unsigned int passes;
+    int bad;
+};
+
+static int verbose;
+
+/*
+ * Support functions
+ */
+
+static void ts_usage(const char *appName)
+{
+    fprintf(stderr, "usage: %s [-v]\n", appName);
+}
+
+static int ts_set_voltage(void *priv, unsigned long u_volt)
+{
+    struct ts_mpu *m = priv;
+
+    if (verbose)
+        printf("    set %lu\n", u_volt);
+    if (u_volt == m->c->bad_set_uv)
+        return -EINVAL;
+    m->u_volt = u_volt;
+    if (!m->lowest_set || u_volt < m->lowest_set)
+        m->lowest_set = u_volt;
+    if (u_volt > m->highest_set)
+        m->highest_set = u_volt;
+    return 0;
+}
+
+static int ts_verify(void *priv)
+{
+    struct ts_mpu *m = priv;
+    int ret = m->u_volt < m->c->vmin_uv ? m->c->verify_err : 0;
+
+    if (verbose)
+        printf("    verify %lu: %s\n", m->u_volt, ret ? "fail" : "pass");
+    if (!m->u_volt) {
+        printf("# %s: verify before any voltage was set\n", m->c->name);
+        m->bad = 1;
+    }
+    if (!m->lowest_verified || m->u_volt < m->lowest_verified)
+        m->lowest_verified = m->u_volt;
+    m->passes++;
+    return ret;
+}
+
+static int ts_should_stop(void *priv)
+{
+    struct ts_mpu *m = priv;
+
+    return m->c->stop_after && m->passes >= m->c->stop_after;
+}
+
+static const struct opp_tune_ops ts_ops = {
+    ts_set_voltage,
+    ts_verify,
+    ts_should_stop,
+};
+
+static int ts_case(const struct ts_case *c)
+{
+    struct opp_tune_params p;
+    struct opp_tune_result r;
+    struct ts_mpu m;
+
+    memset(&m, 0, sizeof(m));
+    m.c = c;
+    if (verbose)
+        printf("# %s\n", c->name);
+    opp_tune_init_params(&p, c->calib_uv, TS_VOLT_MIN, TS_VOLT_MAX);
+    opp_tune_run(&ts_ops, &m, &p, &r);
+
+    if (r.status != c->status || r.min_stable_uv != c->min_stable_uv ||
+        r.failed_uv != c->failed_uv || r.applied_uv != c->applied_uv ||
+        r.steps != c->steps || r.error != c->error) {
+        printf("# %s: got %s %lu %lu %lu %u %d, expected %s %lu %lu %lu %u %d\n",
+            c->name, opp_tune_status_name(r.status), r.min_stable_uv,
+            r.failed_uv, r.applied_uv, r.steps, r.error,
+            opp_tune_status_name(c->status), c->min_stable_uv, c->failed_uv,
+            c->applied_uv, c->steps, c->error);
+        m.bad = 1;
+    }
+    if (r.steps != m.passes) {
+        printf("# %s: %u steps reported, %u verifications run\n", c->name,
+            r.steps, m.passes);
+        m.bad = 1;
+    }
+    if (r.applied_uv != m.u_volt) {
+        printf("# %s: reports %lu, left at %lu\n", c->name, r.applied_uv,
+            m.u_volt);
+        m.bad = 1;
+    }
+    if (m.lowest_set && (m.lowest_set < p.floor_uv || m.highest_set > p.ceil_uv)) {
+        printf("# %s: set %lu..%lu, outside %lu..%lu\n", c->name,
+            m.lowest_set, m.highest_set, p.floor_uv, p.ceil_uv);
+        m.bad = 1;
+    }
+    /* Backing off must never end below the lowest voltage that passed */
+    if (r.min_stable_uv && r.applied_uv < r.min_stable_uv) {
+        printf("# %s: left at %lu, below the last pass at %lu\n", c->name,
+            r.applied_uv, r.min_stable_uv);
+        m.bad = 1;
+    }
+    if (m.bad)
+        printf("# FAIL: %s\n", c->name);
+    else if (verbose)
+        printf("# ok: %s\n", c->name);
+    return m.bad;
+}
+
+/* The workloads must give the same result for the same inputs and
+ * notice a reference that doesn't match */
+static int ts_workloads(int *total)
+{
+    struct opp_tune_ref ref, bad;
+    u32 *mem;
+    int failed = 0;
+
+    mem = malloc(TS_MEM_WORDS * sizeof(*mem));
+    if (mem == NULL) {
+        printf("# FAIL: workloads, out of memory\n");
+        *total += 1;
+        return 1;
+    }
+    opp_tune_ref_init(&ref, mem, TS_MEM_WORDS, TS_SEED, TS_ROUNDS);
+
+    *total += 4;
+    if (opp_tune_ref_check(&ref) != 0) {
+        printf("# FAIL: workloads, reference does not repeat\n");
+        failed++;
+    }
+    bad = ref;
+    bad.cpu_sum ^= 1;
+    if (opp_tune_ref_check(&bad) != -EIO) {
+        printf("# FAIL: workloads, cpu miscompare not seen\n");
+        failed++;
+    }
+    bad = ref;
+    bad.mem_sum ^= 0x80000000u;
+    if (opp_tune_ref_check(&bad) != -EIO) {
+        printf("# FAIL: workloads, mem miscompare not seen\n");
+        failed++;
+    }
+    if (opp_tune_cpu_pass(TS_SEED + 1, TS_ROUNDS) == ref.cpu_sum ||
+        opp_tune_mem_pass(mem, TS_MEM_WORDS, TS_SEED + 1) == ref.mem_sum) {
+        printf("# FAIL: workloads, seed does not change the result\n");
+        failed++;
+    }
+    free(mem);
+    return failed;
+}
+
+/*
+ * Entry point
+ */
+
+int main(int argc, char *argv[])
+{
+    const char *appName = argv[0];
+    int i, opt, failed = 0, total = 0;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            ts_usage(appName);
+            return 2;
+        }
+    }
+
+    for (i = 0; i < TS_COUNT(ts_cases); i++, total++)
+        failed += ts_case(&ts_cases[i]);
+    failed += ts_workloads(&total);
+
+    fprintf(stderr, "%d of %d cases passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+/* 
+ * cache: symbol addresses kept across boots of the same kernel
+ *
+ * Copyright (C) 2026 opptimizer contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Every symbol resolved by a kallsyms walk is remembered here, and the
+ * whole table can be read from and written to /sys/kernel/symsearch/cache
+ * so that a loader can keep it on disk between boots:
+ *
+ *   symcache 1
+ *   release <utsname release>
+ *   version <utsname version>
+ *   anchor <address of kallsyms_on_each_symbol>
+ *   sym <address> <name>
+ *   ...
+ *
+ * A write is only accepted if release, version and anchor all match the
+ * running kernel. Each entry is checked once more with sprint_symbol()
+ * when it is used, which is a binary search, so a stale entry costs a
+ * fallback to the walk and never a wrong address.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/kallsyms.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+#include <linux/utsname.h>
+#include "symcache.h"
+
+#define SYMCACHE_MAGIC		"symcache 1"
+#define SYMCACHE_COUNT		64
+#define SYMCACHE_NAME_LEN	48
+
+extern int kallsyms_on_each_symbol(int (*fn)(void *, const char *, struct module *,
+				      unsigned long),
+			    void *data);
+
+struct symcache_entry
+{
+	char name[SYMCACHE_NAME_LEN];
+	unsigned long address;
+};
+
+static DEFINE_MUTEX(symcache_mutex);
+static struct symcache_entry entries[SYMCACHE_COUNT];
+static int entry_count;
+static struct kobject *symsearch_kobj;
+
+static struct symcache_entry *symcache_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < entry_count; i++)
+	{
+		if (!strcmp(entries[i].name, name))
+			return &entries[i];
+	}
+	return NULL;
+}
+
+/* "name+0x0/0x..." means the address is the start of that symbol */
+static int symcache_verify(const char *name, unsigned long address)
+{
+	char buf[KSYM_SYMBOL_LEN];
+	size_t len = strlen(name);
+
+	sprint_symbol(buf, address);
+	return !strncmp(buf, name, len) && !strncmp(buf + len, "+0x0/", 5);
+}
+
+int symcache_lookup(const char *name, unsigned long *address)
+{
+	struct symcache_entry *e;
+	unsigned long found = 0;
+
+	mutex_lock(&symcache_mutex);
+	e = symcache_find(name);
+	if (e)
+		found = e->address;
+	mutex_unlock(&symcache_mutex);
+
+	if (!found || !symcache_verify(name, found))
+		return -ENOENT;
+	*address = found;
+	return 0;
+}
+
+void symcache_store(const char *name, unsigned long address)
+{
+	struct symcache_entry *e;
+
+	if (strlen(name) >= SYMCACHE_NAME_LEN)
+		return;
+	mutex_lock(&symcache_mutex);
+	e = symcache_find(name);
+	if (!e && entry_count < SYMCACHE_COUNT)
+	{
+		e = &entries[entry_count++];
+		strcpy(e->name, name);
+	}
+	if (e)
+		e->address = address;
+	mutex_unlock(&symcache_mutex);
+}
+
+/* A full table with a long utsname version comes close to a page. Only
+ * whole lines are shown: a cut one would be written back at the next boot
+ * as a bad entry, a missing one only costs a kallsyms walk. */
+static ssize_t cache_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len;
+	int i, n;
+
+	len = scnprintf(buf, PAGE_SIZE, "%s\nrelease %s\nversion %s\nanchor %lx\n",
+			SYMCACHE_MAGIC, utsname()->release, utsname()->version,
+			(unsigned long)&kallsyms_on_each_symbol);
+	mutex_lock(&symcache_mutex);
+	for (i = 0; i < entry_count; i++)
+	{
+		n = snprintf(buf + len, PAGE_SIZE - len, "sym %lx %s\n",
+			     entries[i].address, entries[i].name);
+		if (n >= PAGE_SIZE - len)
+		{
+			buf[len] = 0;
+			printk(KERN_INFO "symsearch: cache too large for one page, %d of %d symbols shown.\n",
+			       i, entry_count);
+			break;
+		}
+		len += n;
+	}
+	mutex_unlock(&symcache_mutex);
+	return len;
+}
+
+/* Compare "<key> <rest of line>" against the running kernel */
+static int cache_check_line(const char *line, const char *key, const char *value)
+{
+	size_t len = strlen(key);
+
+	return !strncmp(line, key, len) && line[len] == ' ' && !strcmp(line + len + 1, value);
+}
+
+static ssize_t cache_store(struct kobject *kobj, struct kobj_attribute *attr,
+			   const char *buf, size_t count)
+{
+	char *copy, *p, *line;
+	char anchor[2 * sizeof(unsigned long) + 1];
+	char name[SYMCACHE_NAME_LEN];
+	unsigned long address;
+	int n = 0, stored = 0, ret = count;
+
+	copy = kstrndup(buf, count, GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+	snprintf(anchor, sizeof(anchor), "%lx", (unsigned long)&kallsyms_on_each_symbol);
+
+	p = copy;
+	while ((line = strsep(&p, "\n")) != NULL)
+	{
+		if (!*line)
+			continue;
+		switch (n++)
+		{
+		case 0:
+			if (strcmp(line, SYMCACHE_MAGIC))
+				ret = -EINVAL;
+			break;
+		case 1:
+			if (!cache_check_line(line, "release", utsname()->release))
+				ret = -ESTALE;
+			break;
+		case 2:
+			if (!cache_check_line(line, "version", utsname()->version))
+				ret = -ESTALE;
+			break;
+		case 3:
+			if (!cache_check_line(line, "anchor", anchor))
+				ret = -ESTALE;
+			break;
+		default:
+			if (sscanf(line, "sym %lx %47s", &address, name) != 2)
+			{
+				ret = -EINVAL;
+				break;
+			}
+			symcache_store(name, address);
+			stored++;
+			break;
+		}
+		if (ret < 0)
+			break;
+	}
+	kfree(copy);
+
+	if (ret == -ESTALE)
+		printk(KERN_INFO "symsearch: cache is for another kernel, ignored.\n");
+	else if (ret >= 0 && n < 4)
+		ret = -EINVAL;
+	else if (ret >= 0)
+		printk(KERN_INFO "symsearch: %d symbols loaded into the cache.\n", stored);
+	return ret;
+}
+
+static struct kobj_attribute cache_attr = __ATTR(cache, 0600, cache_show, cache_store);
+
+int symcache_init(void)
+{
+	int ret;
+
+	symsearch_kobj = kobject_create_and_add("symsearch", kernel_kobj);
+	if (!symsearch_kobj)
+		return -ENOMEM;
+	ret = sysfs_create_file(symsearch_kobj, &cache_attr.attr);
+	if (ret)
+		kobject_put(symsearch_kobj);
+	return ret;
+}
+
+void symcache_exit(void)
+{
+	sysfs_remove_file(symsearch_kobj, &cache_attr.attr);
+	kobject_put(symsearch_kobj);
+}
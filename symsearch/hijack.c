@@ -20,27 +20,41 @@
  */
  
 #include <linux/module.h>
+#include <linux/kernel.h>
+#include <asm/cacheflush.h>
 #include "symsearch.h"
+#include "hook_insn.h"
  
 struct hijack_info hijack_function(unsigned long hijack_address, unsigned long redirection_address)
 {
 	struct hijack_info hijack;
-	unsigned long branch_instr;
+	u32 branch_instr;
 	
 	hijack.hijack_address = hijack_address;
 	hijack.redirection_address = redirection_address;
 	hijack.instruction_backup = *((unsigned long*)(hijack_address));
 	
-	//B redirection_address 
-	//(HEX=0xEA000000 + ((redirection_address - hijack_address + 8)/4 & 0x00FFFFFF) )
-	branch_instr = 0xEA000000 + ((redirection_address - hijack_address + 8)/4 & 0x00FFFFFF);
+	//B redirection_address, +-32MB only (hook_install jumps anywhere)
+	if (hook_arm_encode_b(hijack_address, redirection_address, &branch_instr))
+	{
+		printk(KERN_INFO "symsearch: Can't hijack %pS, too far for a branch.\n",
+			(void *)hijack_address);
+		hijack.hijack_address = 0;
+		return hijack;
+	}
+	
 	*((unsigned long*)(hijack_address)) = branch_instr;
+	flush_icache_range(hijack_address, hijack_address + 4);
 	return hijack;
 }
 EXPORT_SYMBOL(hijack_function);
 
 void restore_function(struct hijack_info hijack)
 {
+	if (!hijack.hijack_address)
+		return;
+	
 	*((unsigned long*)(hijack.hijack_address)) = hijack.instruction_backup;
+	flush_icache_range(hijack.hijack_address, hijack.hijack_address + 4);
 }
 EXPORT_SYMBOL(restore_function);
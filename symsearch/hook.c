@@ -0,0 +1,154 @@
+/*
+ * hook: - hooks functions in kernel, keeping them callable
+ *
+ * Copyright (C) 2026 opptimizer contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/mutex.h>
+#include <linux/stop_machine.h>
+#include <linux/string.h>
+#include <asm/cacheflush.h>
+#include "symsearch.h"
+#include "hook_insn.h"
+
+//trampolines live in a fixed pool inside this module, so they are
+//executable and within B range of the kernel text most of the time.
+//a slot is never handed out again after hook_remove: a task preempted
+//inside the trampoline may still return through it. the pool goes away
+//with the module, which can't happen before its users are unloaded.
+
+#define HOOK_SLOTS		64
+#define HOOK_SLOT_SIZE		64
+
+#define THUMB_NOP		0xBF00
+
+static u32 hook_pool[HOOK_SLOTS][HOOK_SLOT_SIZE / 4] __aligned(HOOK_SLOT_SIZE);
+static int hook_pool_used = 0;
+static DEFINE_MUTEX(hook_mutex);
+
+struct hook_patch
+{
+	unsigned long address;
+	const void *code;
+	int len;
+};
+
+//runs with every other CPU spinning with interrupts off, so nobody can
+//execute the bytes while they are half written
+static int hook_write(void *data)
+{
+	struct hook_patch *patch = data;
+
+	memcpy((void *)patch->address, patch->code, patch->len);
+	flush_icache_range(patch->address, patch->address + patch->len);
+	return 0;
+}
+
+int hook_install(struct hook *hook)
+{
+	unsigned long target = hook->target & ~1UL;
+	int thumb = hook->target & 1;
+	u32 code[HOOK_BACKUP_SIZE / 4];
+	struct hook_patch patch;
+	unsigned long slot;
+	int len, used, covered, ret;
+
+	BUILD_BUG_ON(HOOK_PATCH_MAX > HOOK_BACKUP_SIZE);
+
+	if (hook->patch_len)
+		return -EBUSY;
+
+	mutex_lock(&hook_mutex);
+	if (hook_pool_used == HOOK_SLOTS)
+	{
+		printk(KERN_INFO "symsearch: Out of hook trampolines.\n");
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	slot = (unsigned long)hook_pool[hook_pool_used];
+
+	if (thumb)
+	{
+		len = hook_thumb_encode_jump(target, (u32)(unsigned long)hook->handler, (u16 *)code);
+		used = hook_thumb_relocate((const u16 *)target, target, len,
+			(u16 *)slot, slot, HOOK_SLOT_SIZE, &covered);
+
+		//the last instruction moved may end past the jump
+		for (; used >= 0 && len < covered; len += 2)
+			((u16 *)code)[len / 2] = THUMB_NOP;
+	}
+	else
+	{
+		len = hook_arm_encode_jump(target, (u32)(unsigned long)hook->handler, code);
+		used = hook_arm_relocate((const u32 *)target, target, len,
+			(u32 *)slot, slot, HOOK_SLOT_SIZE, &covered);
+	}
+
+	if (used < 0)
+	{
+		printk(KERN_INFO "symsearch: Can't hook %pS, its first instructions can't be moved.\n",
+			(void *)target);
+		ret = used;
+		goto out;
+	}
+
+	flush_icache_range(slot, slot + used);
+	memcpy(hook->backup, (void *)target, len);
+	hook->orig = (void *)(slot | thumb);
+
+	patch.address = target;
+	patch.code = code;
+	patch.len = len;
+	ret = stop_machine(hook_write, &patch, NULL);
+	if (ret)
+		goto out;
+
+	hook->patch_len = len;
+	hook_pool_used++;
+
+out:
+	mutex_unlock(&hook_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(hook_install);
+
+//the handler may still be running on another task when this returns,
+//the caller has to wait for it before freeing its code
+int hook_remove(struct hook *hook)
+{
+	struct hook_patch patch;
+	int ret;
+
+	if (!hook->patch_len)
+		return -EINVAL;
+
+	patch.address = hook->target & ~1UL;
+	patch.code = hook->backup;
+	patch.len = hook->patch_len;
+
+	mutex_lock(&hook_mutex);
+	ret = stop_machine(hook_write, &patch, NULL);
+	if (!ret)
+		hook->patch_len = 0;
+	mutex_unlock(&hook_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(hook_remove);
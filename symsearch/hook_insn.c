@@ -0,0 +1,292 @@
+/*
+ * hook_insn: instruction encoding and relocation for the hook engine
+ *
+ * Copyright (C) 2026 opptimizer contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Relocation is deliberately conservative. An instruction is copied as
+ * it is unless it reads the PC; the PC relative forms a compiler puts in
+ * a function prologue (B, BL, literal loads and ADR in ARM state) are
+ * rewritten to absolute ones, and anything else that depends on where
+ * it runs is refused, which makes the hook fail instead of the kernel.
+ * In Thumb state every PC relative instruction and IT blocks are refused.
+ */
+
+#include "hook_insn.h"
+
+#define PC_REG			15
+
+#define ARM_COND(i)		((i) >> 28)
+#define ARM_RN(i)		(((i) >> 16) & 0xf)
+#define ARM_RD(i)		(((i) >> 12) & 0xf)
+#define ARM_RM(i)		((i) & 0xf)
+#define ARM_BIT(i, n)		(((i) >> (n)) & 1)
+
+#define ARM_LDR_PC_PC_M4	0xE51FF004	//LDR PC, [PC, #-4]
+#define ARM_LDR_LIT		0x059F0000	//LDR<c> Rt, [PC, #imm12], cond 0
+#define ARM_ADD_LR_PC_8		0x028FE008	//ADD<c> LR, PC, #8, cond 0
+#define ARM_B_NEXT		0xEA000000	//B to the instruction after next
+
+#define THUMB_NOP		0xBF00
+#define THUMB_LDRW_PC_1		0xF8DF		//LDR.W PC, [PC, #0]
+#define THUMB_LDRW_PC_2		0xF000
+
+static int in_range(s32 off, s32 range)
+{
+	return off >= -range && off < range;
+}
+
+int hook_arm_encode_b(u32 from, u32 to, u32 *insn)
+{
+	s32 off = (s32)(to - (from + 8));
+
+	if ((to & 3) || !in_range(off, HOOK_ARM_B_RANGE))
+		return -ERANGE;
+	*insn = 0xEA000000 | (((u32)off >> 2) & 0x00FFFFFF);
+	return 0;
+}
+
+int hook_thumb_encode_b(u32 from, u32 to, u16 *insn)
+{
+	s32 off = (s32)((to & ~1u) - (from + 4));
+	u32 s, i1, i2;
+
+	if (!in_range(off, HOOK_THUMB_B_RANGE))
+		return -ERANGE;
+	s = ((u32)off >> 24) & 1;
+	i1 = ((u32)off >> 23) & 1;
+	i2 = ((u32)off >> 22) & 1;
+	insn[0] = (u16)(0xF000 | (s << 10) | (((u32)off >> 12) & 0x3FF));
+	insn[1] = (u16)(0x9000 | ((!i1 ^ s) << 13) | ((!i2 ^ s) << 11) |
+			(((u32)off >> 1) & 0x7FF));
+	return 0;
+}
+
+int hook_arm_encode_jump(u32 from, u32 to, u32 *buf)
+{
+	if (!(to & 1) && !hook_arm_encode_b(from, to, buf))
+		return 4;
+	buf[0] = ARM_LDR_PC_PC_M4;
+	buf[1] = to;
+	return 8;
+}
+
+int hook_thumb_encode_jump(u32 from, u32 to, u16 *buf)
+{
+	int n = 0;
+
+	if ((to & 1) && !hook_thumb_encode_b(from, to, buf))
+		return 4;
+	//the literal has to be word aligned right behind the LDR
+	if (from & 2)
+		buf[n++] = THUMB_NOP;
+	buf[n++] = THUMB_LDRW_PC_1;
+	buf[n++] = THUMB_LDRW_PC_2;
+	buf[n++] = (u16)(to & 0xFFFF);
+	buf[n++] = (u16)(to >> 16);
+	return n * 2;
+}
+
+int hook_thumb_insn_len(u16 first)
+{
+	return (first & 0xF800) >= 0xE800 ? 4 : 2;
+}
+
+//one ARM instruction at from into out, returns the words written. the
+//rewritten forms only address relative to themselves, so where out
+//runs doesn't matter
+static int arm_reloc_one(u32 insn, u32 from, u32 *out, int room)
+{
+	u32 cond = insn & 0xF0000000;
+	u32 target, imm, rot;
+
+	if (ARM_COND(insn) == 0xF)
+		return -EINVAL;
+
+	//B, BL: absolute through a literal
+	if ((insn & 0x0E000000) == 0x0A000000)
+	{
+		target = from + 8 + ((u32)((s32)(insn << 8) >> 6));
+		if (room < 4)
+			return -ENOSPC;
+		if (ARM_BIT(insn, 24))
+		{
+			out[0] = cond | ARM_ADD_LR_PC_8;	//LR = out + 16
+			out[1] = cond | ARM_LDR_LIT | (PC_REG << 12);	//PC = out[3]
+			out[2] = ARM_B_NEXT;
+			out[3] = target;
+			return 4;
+		}
+		out[0] = cond | ARM_LDR_LIT | (PC_REG << 12);	//PC = out[2]
+		out[1] = ARM_B_NEXT;
+		out[2] = target;
+		return 3;
+	}
+
+	//LDR/STR word and byte
+	if ((insn & 0x0C000000) == 0x04000000)
+	{
+		if (ARM_BIT(insn, 25) && ARM_RM(insn) == PC_REG)
+			return -EINVAL;
+		if (!ARM_BIT(insn, 20) && ARM_RD(insn) == PC_REG)
+			return -EINVAL;
+		if (ARM_RN(insn) != PC_REG)
+			goto copy;
+		//only LDR Rt, [PC, #+-imm] can be rewritten
+		if (ARM_BIT(insn, 25) || !ARM_BIT(insn, 24) || ARM_BIT(insn, 21) ||
+		    !ARM_BIT(insn, 20) || ARM_RD(insn) == PC_REG)
+			return -EINVAL;
+		imm = insn & 0xFFF;
+		target = ARM_BIT(insn, 23) ? from + 8 + imm : from + 8 - imm;
+		if (room < 4)
+			return -ENOSPC;
+		out[0] = cond | ARM_LDR_LIT | (ARM_RD(insn) << 12) | 4;
+		out[1] = (insn & ~0x000F0FFFu) | (1u << 23) | (ARM_RD(insn) << 16);
+		out[2] = ARM_B_NEXT;
+		out[3] = target;
+		return 4;
+	}
+
+	//data processing, multiplies, extra loads and stores, BX
+	if ((insn & 0x0C000000) == 0)
+	{
+		if (!ARM_BIT(insn, 25) && ARM_RM(insn) == PC_REG)
+			return -EINVAL;
+		if (ARM_RN(insn) != PC_REG)
+			goto copy;
+		//ADR, i.e. ADD/SUB Rd, PC, #imm without S
+		if (!ARM_BIT(insn, 25) || ARM_BIT(insn, 20) || ARM_RD(insn) == PC_REG ||
+		    (((insn >> 21) & 0xF) != 0x4 && ((insn >> 21) & 0xF) != 0x2))
+			return -EINVAL;
+		rot = ((insn >> 8) & 0xF) * 2;
+		imm = insn & 0xFF;
+		imm = rot ? (imm >> rot) | (imm << (32 - rot)) : imm;
+		target = ((insn >> 21) & 0xF) == 0x4 ? from + 8 + imm : from + 8 - imm;
+		if (room < 3)
+			return -ENOSPC;
+		out[0] = cond | ARM_LDR_LIT | (ARM_RD(insn) << 12);
+		out[1] = ARM_B_NEXT;
+		out[2] = target;
+		return 3;
+	}
+
+	//LDM/STM: PC as the base, or stored
+	if ((insn & 0x0E000000) == 0x08000000)
+	{
+		if (ARM_RN(insn) == PC_REG || (!ARM_BIT(insn, 20) && ARM_BIT(insn, 15)))
+			return -EINVAL;
+		goto copy;
+	}
+
+	//LDC/STC relative to the PC
+	if ((insn & 0x0E000000) == 0x0C000000 && ARM_RN(insn) == PC_REG)
+		return -EINVAL;
+
+copy:
+	if (room < 1)
+		return -ENOSPC;
+	out[0] = insn;
+	return 1;
+}
+
+int hook_arm_relocate(const u32 *code, u32 from, int len,
+                      u32 *tramp, u32 tramp_addr, int tramp_size, int *covered)
+{
+	int words = tramp_size / 4, used = 0, moved = 0, n;
+	u32 back[2];
+
+	while (moved < len)
+	{
+		n = arm_reloc_one(code[moved / 4], from + moved, tramp + used, words - used);
+		if (n < 0)
+			return n;
+		used += n;
+		moved += 4;
+	}
+
+	n = hook_arm_encode_jump(tramp_addr + used * 4, from + moved, back);
+	if (used + n / 4 > words)
+		return -ENOSPC;
+	tramp[used] = back[0];
+	if (n == 8)
+		tramp[used + 1] = back[1];
+	*covered = moved;
+	return used * 4 + n;
+}
+
+//can the Thumb instruction at code run from another address?
+static int thumb_movable(const u16 *code)
+{
+	u16 hw = code[0];
+
+	if (hook_thumb_insn_len(hw) == 2)
+	{
+		if ((hw & 0xF800) == 0x4800 ||		//LDR literal
+		    (hw & 0xF800) == 0xA000 ||		//ADR
+		    (hw & 0xF800) == 0xE000 ||		//B
+		    (hw & 0xF500) == 0xB100)		//CBZ, CBNZ
+			return 0;
+		if ((hw & 0xF000) == 0xD000 && (hw & 0xFF00) != 0xDF00)
+			return 0;			//B<c>
+		if ((hw & 0xFF00) == 0xBF00 && (hw & 0x000F))
+			return 0;			//IT
+		if ((hw & 0xFC00) == 0x4400 &&		//high register ops, BX
+		    (((hw >> 3) & 0xF) == PC_REG || (((hw >> 4) & 0x8) | (hw & 0x7)) == PC_REG))
+			return 0;
+		return 1;
+	}
+
+	if ((hw & 0xF800) == 0xF000 && (code[1] & 0x8000))
+		return 0;				//B.W, BL, BLX and friends
+	if ((hw & 0xFFF0) == 0xE8D0)
+		return 0;				//TBB, TBH
+	if ((hw & 0xF) == PC_REG &&
+	    ((hw & 0xF800) == 0xE800 || (hw & 0xF800) == 0xF800 || (hw & 0xF800) == 0xF000))
+		return 0;				//PC as Rn: literals, ADR.W
+	return 1;
+}
+
+int hook_thumb_relocate(const u16 *code, u32 from, int len,
+                        u16 *tramp, u32 tramp_addr, int tramp_size, int *covered)
+{
+	int halfs = tramp_size / 2, used = 0, moved = 0, n, i;
+	u16 back[5];
+
+	from &= ~1u;
+	tramp_addr &= ~1u;
+	while (moved < len)
+	{
+		n = hook_thumb_insn_len(code[moved / 2]) / 2;
+		if (!thumb_movable(code + moved / 2))
+			return -EINVAL;
+		if (used + n > halfs)
+			return -ENOSPC;
+		for (i = 0; i < n; i++)
+			tramp[used++] = code[moved / 2 + i];
+		moved += n * 2;
+	}
+
+	n = hook_thumb_encode_jump(tramp_addr + used * 2, (from + moved) | 1, back) / 2;
+	if (used + n > halfs)
+		return -ENOSPC;
+	for (i = 0; i < n; i++)
+		tramp[used++] = back[i];
+	*covered = moved;
+	return used * 2;
+}
@@ -0,0 +1,72 @@
+/*
+ * hook_insn: instruction encoding and relocation for the hook engine
+ *
+ * Copyright (C) 2026 opptimizer contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef _HOOK_INSN_H_
+#define _HOOK_INSN_H_
+
+//plain C only: everything works on buffers and the addresses they will
+//run at, so it can be built on a host and checked with a disassembler.
+//little endian ARMv7, Thumb-2 code is a stream of halfwords.
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/errno.h>
+#else
+#include <stdint.h>
+#include <errno.h>
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int32_t s32;
+#endif
+
+#define HOOK_ARM_B_RANGE	(32 << 20)	//B reaches +-32MB
+#define HOOK_THUMB_B_RANGE	(16 << 20)	//B.W reaches +-16MB
+
+//longest patch written over a target: [NOP] LDR.W PC, [PC] ; .word
+#define HOOK_PATCH_MAX		12
+
+//addresses with bit 0 set are Thumb, as in a BX target
+
+//B from an ARM instruction at from to to, -ERANGE if out of reach
+int hook_arm_encode_b(u32 from, u32 to, u32 *insn);
+//B.W from a Thumb instruction at from, two halfwords
+int hook_thumb_encode_b(u32 from, u32 to, u16 *insn);
+
+//jump from from to to (bit 0 = Thumb), returns the bytes written.
+//a direct branch when in range and no state change, LDR PC otherwise.
+int hook_arm_encode_jump(u32 from, u32 to, u32 *buf);
+int hook_thumb_encode_jump(u32 from, u32 to, u16 *buf);
+
+//2 or 4, from the first halfword of a Thumb instruction
+int hook_thumb_insn_len(u16 first);
+
+//move the instructions covering at least len bytes at from (their code
+//is at code) into tramp, which will run at tramp_addr, and append a
+//jump back to the first instruction not moved. returns the bytes used
+//in tramp and stores the bytes moved in covered; -EINVAL if one of the
+//instructions can't run from another address, -ENOSPC if tramp_size
+//is too small.
+int hook_arm_relocate(const u32 *code, u32 from, int len,
+                      u32 *tramp, u32 tramp_addr, int tramp_size, int *covered);
+int hook_thumb_relocate(const u16 *code, u32 from, int len,
+                        u16 *tramp, u32 tramp_addr, int tramp_size, int *covered);
+
+#endif
@@ -0,0 +1,291 @@
+/* insntest.c - check the hook engine's instruction encoding on a host
+ *
+ * Copyright (C) 2026 opptimizer contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Host tool, not shipped in the package. It links the same hook_insn.c
+ * symsearch.ko uses, encodes jumps and relocates sample prologues, and
+ * compares every word written with the expected encoding. The expected
+ * words were checked with an ARMv7 disassembler; -v prints what was
+ * written, one instruction per line as bytes, so it can be fed back to
+ * one:
+ *     ./insntest -v | llvm-mc -triple=armv7 -disassemble
+ * with -triple=thumbv7 for the Thumb cases.
+ *
+ * Exit status is 0 if every case matches, 1 otherwise.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hook_insn.h"
+
+/*
+ * Local definitions
+ */
+
+#define IT_WORDS_MAX        8
+#define IT_TRAMP_SIZE       64
+
+/* Kernel text and module space are about 17MB apart on the N9, too far
+ * for a Thumb B.W but close enough for an ARM B */
+#define IT_FROM             0xC0100000u
+#define IT_TRAMP            0xBF000000u
+#define IT_TRAMP_NEAR       0xC0200000u     /* 1MB away */
+#define IT_TRAMP_FAR        0x00008000u     /* out of B range */
+
+/* A relocation: code at from, moved to a trampoline at tramp. Thumb
+ * code and output are halfwords, stored one per element. */
+struct it_reloc {
+    const char *name;
+    int thumb;
+    u32 from;
+    u32 code[4];
+    int ncode;
+    int len;
+    u32 tramp;
+    int ret;
+    int covered;
+    u32 out[IT_WORDS_MAX];
+};
+
+/* A jump from from to to, bit 0 of to selects Thumb */
+struct it_jump {
+    const char *name;
+    int thumb;
+    u32 from;
+    u32 to;
+    int ret;
+    u32 out[IT_WORDS_MAX];
+};
+
+static const struct it_reloc it_relocs[] = {
+    /* push {r4, lr}; bl +0x1000 - the function tracer's prologue */
+    { "arm push; bl", 0, IT_FROM, { 0xE92D4010, 0xEB000400 }, 2, 8,
+      IT_TRAMP, 24, 8,
+      { 0xE92D4010,         /* push {r4, lr} */
+        0xE28FE008,         /* add lr, pc, #8 */
+        0xE59FF000,         /* ldr pc, [pc] */
+        0xEA000000,         /* b over the literal */
+        0xC010100C,         /* the BL target */
+        0xEA43FFFB } },     /* b back to from + 8 */
+    { "arm b", 0, IT_FROM, { 0xEA000010 }, 1, 4,
+      IT_TRAMP, 16, 4,
+      { 0xE59FF000, 0xEA000000, 0xC0100048, 0xEA43FFFC } },
+    { "arm bleq", 0, IT_FROM, { 0x0B000400 }, 1, 4,
+      IT_TRAMP, 20, 4,
+      { 0x028FE008,         /* addeq lr, pc, #8 */
+        0x059FF000,         /* ldreq pc, [pc] */
+        0xEA000000, 0xC0101008, 0xEA43FFFB } },
+    { "arm ldr literal", 0, IT_FROM, { 0xE59F3020 }, 1, 4,
+      IT_TRAMP, 20, 4,
+      { 0xE59F3004,         /* ldr r3, [pc, #4] */
+        0xE5933000,         /* ldr r3, [r3] */
+        0xEA000000, 0xC0100028, 0xEA43FFFB } },
+    { "arm ldr literal, negative", 0, IT_FROM, { 0xE51F0008 }, 1, 4,
+      IT_TRAMP, 20, 4,
+      { 0xE59F0004, 0xE5900000, 0xEA000000, 0xC0100000, 0xEA43FFFB } },
+    { "arm adr", 0, IT_FROM, { 0xE28F2010 }, 1, 4,
+      IT_TRAMP, 16, 4,
+      { 0xE59F2000,         /* ldr r2, [pc] */
+        0xEA000000, 0xC0100018, 0xEA43FFFC } },
+    { "arm adr, sub", 0, IT_FROM, { 0xE24F2004 }, 1, 4,
+      IT_TRAMP, 16, 4,
+      { 0xE59F2000, 0xEA000000, 0xC0100004, 0xEA43FFFC } },
+    { "arm mov, far back", 0, IT_FROM, { 0xE1A00001 }, 1, 4,
+      IT_TRAMP_FAR, 12, 4,
+      { 0xE1A00001,
+        0xE51FF004,         /* ldr pc, [pc, #-4] */
+        0xC0100004 } },
+    { "arm ldr pc literal", 0, IT_FROM, { 0xE59FF004 }, 1, 4,
+      IT_TRAMP, -EINVAL, 0, { 0 } },
+    { "arm add r0, pc, r1", 0, IT_FROM, { 0xE08F0001 }, 1, 4,
+      IT_TRAMP, -EINVAL, 0, { 0 } },
+    { "arm blx imm", 0, IT_FROM, { 0xFA000000 }, 1, 4,
+      IT_TRAMP, -EINVAL, 0, { 0 } },
+
+    /* push {r4, lr}; mov r4, r0 */
+    { "thumb push; mov", 1, IT_FROM, { 0xB510, 0x4604 }, 2, 4,
+      IT_TRAMP, 12, 4,
+      { 0xB510, 0x4604,
+        0xF8DF, 0xF000,     /* ldr.w pc, [pc] */
+        0x0005, 0xC010 } },
+    /* the jump back starts on a halfword: nop first */
+    { "thumb push, aligning nop", 1, IT_FROM, { 0xB510 }, 1, 2,
+      IT_TRAMP, 12, 2,
+      { 0xB510, 0xBF00, 0xF8DF, 0xF000, 0x0003, 0xC010 } },
+    { "thumb stmdb, near back", 1, IT_FROM, { 0xE92D, 0x40F0 }, 2, 4,
+      IT_TRAMP_NEAR, 8, 4,
+      { 0xE92D, 0x40F0,
+        0xF6FF, 0xBFFE } }, /* b.w from + 4 */
+    { "thumb ldr literal", 1, IT_FROM, { 0x4801 }, 1, 2,
+      IT_TRAMP, -EINVAL, 0, { 0 } },
+    { "thumb ldr.w literal", 1, IT_FROM, { 0xF8DF, 0x0008 }, 2, 4,
+      IT_TRAMP, -EINVAL, 0, { 0 } },
+    { "thumb bl", 1, IT_FROM, { 0xF000, 0xF800 }, 2, 4,
+      IT_TRAMP, -EINVAL, 0, { 0 } },
+    { "thumb it", 1, IT_FROM, { 0xBF08, 0x2000 }, 2, 4,
+      IT_TRAMP, -EINVAL, 0, { 0 } },
+};
+
+static const struct it_jump it_jumps[] = {
+    { "arm b forward", 0, IT_FROM, IT_FROM + 0x100, 4, { 0xEA00003E } },
+    { "arm b backward", 0, IT_FROM, IT_FROM - 0x1000, 4, { 0xEAFFFBFE } },
+    { "arm to thumb", 0, IT_FROM, IT_FROM + 0x101, 8,
+      { 0xE51FF004, 0xC0100101 } },
+    { "arm out of range", 0, IT_FROM, IT_TRAMP_FAR, 8,
+      { 0xE51FF004, IT_TRAMP_FAR } },
+    { "thumb b.w forward", 1, IT_FROM, IT_FROM + 0x101, 4,
+      { 0xF000, 0xB87E } },
+    { "thumb b.w backward", 1, IT_FROM, (IT_FROM - 0x1000) | 1, 4,
+      { 0xF7FE, 0xBFFE } },
+    { "thumb ldr.w", 1, IT_FROM, IT_TRAMP_FAR | 1, 8,
+      { 0xF8DF, 0xF000, 0x8001, 0x0000 } },
+    { "thumb ldr.w, aligning nop", 1, IT_FROM + 2, IT_TRAMP_FAR | 1, 10,
+      { 0xBF00, 0xF8DF, 0xF000, 0x8001, 0x0000 } },
+    { "thumb to arm", 1, IT_FROM, IT_FROM + 0x100, 8,
+      { 0xF8DF, 0xF000, 0x0100, 0xC010 } },
+};
+
+#define IT_COUNT(a)         ((int)(sizeof(a) / sizeof((a)[0])))
+
+static int verbose;
+
+/*
+ * Support functions
+ */
+
+static void it_usage(const char *appName)
+{
+    fprintf(stderr, "usage: %s [-v]\n", appName);
+}
+
+/* Compare n units of got with want, report the case if they differ */
+static int it_check(const char *name, int ret, int want_ret, int covered,
+                    int want_covered, const u32 *got, const u32 *want,
+                    int n, int thumb)
+{
+    int i, bad = ret != want_ret || covered != want_covered;
+
+    for (i = 0; !bad && i < n; i++)
+        bad = got[i] != want[i];
+    if (verbose || bad) {
+        printf("# %s: %s, ret %d (%d) covered %d (%d)\n", bad ? "FAIL" : "ok",
+            name, ret, want_ret, covered, want_covered);
+        for (i = 0; i < n; i++) {
+            if (thumb)
+                printf("0x%02x 0x%02x", got[i] & 0xFF, (got[i] >> 8) & 0xFF);
+            else
+                printf("0x%02x 0x%02x 0x%02x 0x%02x", got[i] & 0xFF,
+                    (got[i] >> 8) & 0xFF, (got[i] >> 16) & 0xFF, got[i] >> 24);
+            if (got[i] != want[i])
+                printf("  # expected %0*x", thumb ? 4 : 8, want[i]);
+            printf("\n");
+        }
+    }
+    return bad;
+}
+
+static int it_reloc(const struct it_reloc *c)
+{
+    u32 code32[4], tramp32[IT_TRAMP_SIZE / 4], got[IT_WORDS_MAX];
+    u16 code16[4], tramp16[IT_TRAMP_SIZE / 2];
+    int i, ret, n, covered = 0;
+
+    memset(got, 0, sizeof(got));
+    if (c->thumb) {
+        for (i = 0; i < c->ncode; i++)
+            code16[i] = (u16)c->code[i];
+        ret = hook_thumb_relocate(code16, c->from | 1, c->len, tramp16,
+            c->tramp | 1, sizeof(tramp16), &covered);
+        n = ret > 0 ? ret / 2 : 0;
+        for (i = 0; i < n && i < IT_WORDS_MAX; i++)
+            got[i] = tramp16[i];
+    } else {
+        for (i = 0; i < c->ncode; i++)
+            code32[i] = c->code[i];
+        ret = hook_arm_relocate(code32, c->from, c->len, tramp32, c->tramp,
+            sizeof(tramp32), &covered);
+        n = ret > 0 ? ret / 4 : 0;
+        for (i = 0; i < n && i < IT_WORDS_MAX; i++)
+            got[i] = tramp32[i];
+    }
+    if (n > IT_WORDS_MAX)
+        n = IT_WORDS_MAX;
+    return it_check(c->name, ret, c->ret, covered, c->covered, got, c->out,
+        n, c->thumb);
+}
+
+static int it_jump(const struct it_jump *c)
+{
+    u32 buf32[IT_WORDS_MAX], got[IT_WORDS_MAX];
+    u16 buf16[IT_WORDS_MAX];
+    int i, ret, n;
+
+    memset(got, 0, sizeof(got));
+    if (c->thumb) {
+        ret = hook_thumb_encode_jump(c->from, c->to, buf16);
+        n = ret / 2;
+        for (i = 0; i < n; i++)
+            got[i] = buf16[i];
+    } else {
+        ret = hook_arm_encode_jump(c->from, c->to, buf32);
+        n = ret / 4;
+        for (i = 0; i < n; i++)
+            got[i] = buf32[i];
+    }
+    return it_check(c->name, ret, c->ret, 0, 0, got, c->out, n, c->thumb);
+}
+
+/*
+ * Entry point
+ */
+
+int main(int argc, char *argv[])
+{
+    const char *appName = argv[0];
+    u32 tramp[2];
+    int i, opt, covered, failed = 0, total = 0;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            it_usage(appName);
+            return 2;
+        }
+    }
+
+    for (i = 0; i < IT_COUNT(it_jumps); i++, total++)
+        failed += it_jump(&it_jumps[i]);
+    for (i = 0; i < IT_COUNT(it_relocs); i++, total++)
+        failed += it_reloc(&it_relocs[i]);
+
+    /* A trampoline too small for the BL case above */
+    total++;
+    covered = 0;
+    if (hook_arm_relocate(it_relocs[0].code + 1, IT_FROM + 4, 4, tramp,
+            IT_TRAMP, sizeof(tramp), &covered) != -ENOSPC) {
+        printf("# FAIL: arm bl, no room\n");
+        failed++;
+    }
+
+    fprintf(stderr, "%d of %d cases passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -24,12 +24,14 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/string.h>
+#include <linux/slab.h>
 #include "symsearch.h"
+#include "symcache.h"
 
 MODULE_AUTHOR("Skrilax_CZ");
 MODULE_DESCRIPTION("Symbol search module");
 MODULE_LICENSE("GPL");
-MODULE_VERSION("1.1");
+MODULE_VERSION("1.4");
 
 extern int kallsyms_on_each_symbol(int (*fn)(void *, const char *, struct module *,
 				      unsigned long),
@@ -38,6 +40,8 @@ extern int kallsyms_on_each_symbol(int (*fn)(void *, const char *, struct module
 SYMSEARCH_INIT_FUNCTION(lookup_symbol_address);
 EXPORT_SYMBOL_GPL(lookup_symbol_address);
 
+static lookup_symbol_address_fp kallsyms_lookup_name_fp;
+
 static int find_kallsyms_lookup_name(void* data, const char* name, 
                           struct module * module, unsigned long address)
 {
@@ -45,28 +49,150 @@ static int find_kallsyms_lookup_name(void* data, const char* name,
 	if (!strcmp(name, "kallsyms_lookup_name"))
 	{
 		printk(KERN_INFO "symsearch: found kallsyms_lookup_name on 0x%lx.\n", address);
-		lookup_symbol_address = (lookup_symbol_address_fp)address;
+		kallsyms_lookup_name_fp = (lookup_symbol_address_fp)address;
 		return 1;
 	}
 
 	return 0;
 } 
 
-static int __init symsearch_init(void)
+/* lookup_symbol_address points here. Cached symbols need no search at
+ * all, and kallsyms_lookup_name itself is only looked for on the first
+ * miss, by then the cache may already have it. */
+static unsigned long lookup_name(const char *name)
+{
+	unsigned long address;
+
+	if (!symcache_lookup(name, &address))
+		return address;
+
+	if (!kallsyms_lookup_name_fp)
+	{
+		if (!symcache_lookup("kallsyms_lookup_name", &address))
+			kallsyms_lookup_name_fp = (lookup_symbol_address_fp)address;
+		else
+			kallsyms_on_each_symbol(&find_kallsyms_lookup_name, NULL);
+		if (!kallsyms_lookup_name_fp)
+		{
+			printk(KERN_ERR "symsearch: could not find kallsyms_lookup_name.\n");
+			return 0;
+		}
+		symcache_store("kallsyms_lookup_name", (unsigned long)kallsyms_lookup_name_fp);
+	}
+
+	address = kallsyms_lookup_name_fp(name);
+	if (address)
+		symcache_store(name, address);
+	return address;
+}
+
+/* Batch lookup: the requested names go into an open addressing hash
+ * table, then a single kallsyms walk fills them all in and stops as soon
+ * as the last one is found. Like kallsyms_lookup_name, the first symbol
+ * of a name wins. */
+
+struct batch_slot
+{
+	u32 hash;
+	struct symsearch_request *req;
+};
+
+struct batch_state
+{
+	struct batch_slot *slots;
+	unsigned int mask;
+	int left;
+};
+
+static u32 batch_hash(const char *name)
+{
+	u32 hash = 2166136261u;	/* FNV-1a */
+
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 16777619u;
+	return hash;
+}
+
+static int batch_match(void *data, const char *name,
+                       struct module *module, unsigned long address)
+{
+	struct batch_state *st = data;
+	u32 hash = batch_hash(name);
+	unsigned int i;
+
+	for (i = hash & st->mask; st->slots[i].req; i = (i + 1) & st->mask)
+	{
+		if (st->slots[i].hash != hash || *st->slots[i].req->address ||
+		    strcmp(st->slots[i].req->name, name))
+			continue;
+		*st->slots[i].req->address = address;
+		st->left--;
+	}
+
+	return st->left == 0;
+}
+
+int symsearch_lookup_batch(const char *module, struct symsearch_request *req, int count)
 {
-	/* kallsyms export the kallsyms_on_each_symbol so use that */
-	kallsyms_on_each_symbol(&find_kallsyms_lookup_name, NULL);
-	if(!lookup_symbol_address) 
+	struct batch_state st;
+	unsigned int size = 1, i;
+	int n, cached = 0;
+
+	/* at most half full, so probes stay short */
+	while (size < 2 * count)
+		size <<= 1;
+	st.slots = kcalloc(size, sizeof(*st.slots), GFP_KERNEL);
+	if (!st.slots)
+		return -ENOMEM;
+	st.mask = size - 1;
+	st.left = count;
+
+	for (n = 0; n < count; n++)
 	{
-		printk(KERN_ERR "symsearch: could not find kallsyms_lookup_name.\n");
-		return -EBUSY;
+		*req[n].address = 0;
+		if (!symcache_lookup(req[n].name, req[n].address))
+		{
+			st.left--;
+			cached++;
+			continue;
+		}
+		for (i = batch_hash(req[n].name) & st.mask; st.slots[i].req; i = (i + 1) & st.mask)
+			;
+		st.slots[i].hash = batch_hash(req[n].name);
+		st.slots[i].req = &req[n];
+	}
+
+	if (st.left)
+		kallsyms_on_each_symbol(&batch_match, &st);
+	kfree(st.slots);
+	if (cached)
+		printk(KERN_INFO "%s: %d of %d symbols from the cache.\n", module, cached, count);
+
+	for (n = 0; n < count; n++)
+	{
+		if (!*req[n].address)
+			printk(KERN_INFO "%s: Could not find symbol: %s.\n", module, req[n].name);
+		else
+			symcache_store(req[n].name, *req[n].address);
+	}
+	if (st.left)
+	{
+		printk(KERN_ERR "%s: %d of %d symbols missing.\n", module, st.left, count);
+		return -ENOENT;
 	}
-	
 	return 0;
 }
+EXPORT_SYMBOL_GPL(symsearch_lookup_batch);
+
+static int __init symsearch_init(void)
+{
+	/* kallsyms_lookup_name is found on first use, see lookup_name() */
+	lookup_symbol_address = &lookup_name;
+	return symcache_init();
+}
 
 static void __exit symsearch_exit(void){
-	
+	symcache_exit();
 };
 
 module_init(symsearch_init);
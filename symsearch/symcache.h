@@ -0,0 +1,32 @@
+/*
+ * symcache: symbol addresses kept across boots of the same kernel
+ *
+ * Copyright (C) 2026 opptimizer contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef _SYMCACHE_H_
+#define _SYMCACHE_H_
+
+//internal to symsearch, see cache.c
+
+int symcache_lookup(const char *name, unsigned long *address);
+void symcache_store(const char *name, unsigned long address);
+int symcache_init(void);
+void symcache_exit(void);
+
+#endif
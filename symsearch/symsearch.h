@@ -91,8 +91,31 @@
 		return -EBUSY; \
 	}
 
+//batch binding (one kallsyms walk for a whole table, see search.c)
+
+struct symsearch_request
+{
+	const char *name;
+	unsigned long *address;
+};
+
+#define SYMSEARCH_REQUEST_ADDRESS(name) \
+	{ #name, &name##_address }
+
+#define SYMSEARCH_REQUEST_FUNCTION(name) \
+	{ #name, (unsigned long *)&name }
+
+#define SYMSEARCH_REQUEST_FUNCTION_TO(name,sym) \
+	{ #name, (unsigned long *)&sym }
+
+//fills every entry of table, logs each symbol not found and fails if any
+#define SYMSEARCH_BIND_TABLE(module,table) \
+	if(symsearch_lookup_batch(#module, table, ARRAY_SIZE(table))) \
+		return -EBUSY;
+
 //hijcaking	a function
-//injects a Branch instruction to the function beginning
+//injects a Branch instruction to the function beginning, there is no
+//way to call the original. hijack_address is 0 when out of B range
 
 //ARM MODE only !!!
 
@@ -103,9 +126,32 @@ struct hijack_info
 	unsigned long instruction_backup;
 };
 
+//hooking a function (see hook.c)
+//the start of target is moved to a trampoline and replaced by a jump to
+//handler, which can call the original function through orig. works for
+//ARM and Thumb-2 code at any distance. bit 0 of target, handler and orig
+//is set for Thumb code, as in a BX target
+
+#define HOOK_BACKUP_SIZE 16
+
+struct hook
+{
+	unsigned long target;
+	void *handler;
+	void *orig;
+	
+	//private
+	unsigned char backup[HOOK_BACKUP_SIZE];
+	int patch_len;
+};
+
 SYMSEARCH_DECLARE_FUNCTION(unsigned long, lookup_symbol_address, const char *name);
+int symsearch_lookup_batch(const char *module, struct symsearch_request *req, int count);
 	
 struct hijack_info hijack_function(unsigned long hijack_address, unsigned long redirection_address);
 void restore_function(struct hijack_info hijack);
+
+int hook_install(struct hook *hook);
+int hook_remove(struct hook *hook);
 	
 #endif